@@ -15,25 +15,105 @@
 */
 
 #include "kuhn_munkres.hpp"
+#include <algorithm>
+#include <limits>
 #include <utility>
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KUHN_MUNKRES_SSE2
+#include <emmintrin.h>
+#endif
 
 
-KuhnMunkres::Indexes KuhnMunkres::calculate(const Grid &grid)
+namespace {
+const std::size_t Alignment = 64;
+const int BlockSize = Alignment / sizeof(double);
+const double Infinity = std::numeric_limits<double>::infinity();
+
+
+// Returns the smallest of row[i] + mask[i]; the mask holds 0 for the
+// columns to consider and infinity for those to skip. Both must be
+// aligned and count a multiple of BlockSize.
+double masked_minimum(const double *row, const double *mask, int count)
 {
-    grid_ = grid;
-    const Dimensions dimensions = ensure_grid_is_square();
-    size = static_cast<int>(grid_.size());
-#ifdef USE_STL
-    row_covered.resize(size, false);
-    column_covered.resize(size, false);
+#ifdef KUHN_MUNKRES_SSE2
+    __m128d minimum0 = _mm_set1_pd(Infinity);
+    __m128d minimum1 = minimum0;
+    for (int i = 0; i < count; i += 4) {
+        minimum0 = _mm_min_pd(minimum0, _mm_add_pd(
+                _mm_load_pd(row + i), _mm_load_pd(mask + i)));
+        minimum1 = _mm_min_pd(minimum1, _mm_add_pd(
+                _mm_load_pd(row + i + 2), _mm_load_pd(mask + i + 2)));
+    }
+    minimum0 = _mm_min_pd(minimum0, minimum1);
+    minimum0 = _mm_min_sd(minimum0, _mm_unpackhi_pd(minimum0, minimum0));
+    return _mm_cvtsd_f64(minimum0);
 #else
-    row_covered.fill(false, size);
-    column_covered.fill(false, size);
+    double minimum[4] = {Infinity, Infinity, Infinity, Infinity};
+    for (int i = 0; i < count; i += 4)
+        for (int j = 0; j < 4; ++j)
+            minimum[j] = std::min(minimum[j], row[i + j] + mask[i + j]);
+    return std::min(std::min(minimum[0], minimum[1]),
+                    std::min(minimum[2], minimum[3]));
 #endif
+}
+
+
+// Adds offsets[i] to row[i], with the same requirements as above
+void add_offsets(double *row, const double *offsets, int count)
+{
+#ifdef KUHN_MUNKRES_SSE2
+    for (int i = 0; i < count; i += 4) {
+        _mm_store_pd(row + i, _mm_add_pd(_mm_load_pd(row + i),
+                                         _mm_load_pd(offsets + i)));
+        _mm_store_pd(row + i + 2, _mm_add_pd(_mm_load_pd(row + i + 2),
+                                             _mm_load_pd(offsets + i + 2)));
+    }
+#else
+    for (int i = 0; i < count; ++i)
+        row[i] += offsets[i];
+#endif
+}
+
+
+// Returns the index of the last element of row[i] + mask[i] that
+// KuhnMunkres::is_zero(), or -1, with the same requirements as above
+int last_zero(const double *row, const double *mask, int count)
+{
+#ifdef KUHN_MUNKRES_SSE2
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d epsilon = _mm_set1_pd(DBL_EPSILON);
+    for (int i = count - 2; i >= 0; i -= 2) {
+        const __m128d value = _mm_andnot_pd(sign, _mm_add_pd(
+                _mm_load_pd(row + i), _mm_load_pd(mask + i)));
+        const int zeros = _mm_movemask_pd(_mm_cmple_pd(value, epsilon));
+        if (zeros)
+            return i + ((zeros & 2) ? 1 : 0);
+    }
+#else
+    for (int i = count - 1; i >= 0; --i)
+        if (KuhnMunkres::is_zero(row[i] + mask[i]))
+            return i;
+#endif
+    return -1;
+}
+
+} // anonymous namespace
+
+
+KuhnMunkres::Indexes KuhnMunkres::calculate(const Grid &grid)
+{
+    int rows_used;
+    int columns_used;
+    copy_grid(grid, &rows_used, &columns_used);
+    row_covered.resize(size);
+    column_covered.resize(size);
     z0_row = 0;
     z0_column = 0;
-    path = make_grid(size * 2, static_cast<int>(ZERO));
-    marked = make_grid(size, static_cast<int>(ZERO));
+    path.assign((size * 2 + 1) * 2, 0);
+    star_in_row.assign(size, -1);
+    star_in_column.assign(size, -1);
+    prime_in_row.assign(size, -1);
 
     int step = 1;
     while (step) {
@@ -49,92 +129,72 @@ KuhnMunkres::Indexes KuhnMunkres::calculate(const Grid &grid)
     }
 
     Indexes indexes;
-    for (int row = 0; row < size; ++row) {
-        for (int column = 0; column < size; ++column) {
-            if ((row < dimensions.first) &&
-                (column < dimensions.second) &&
-                marked.at(row).at(column) == STAR)
+    for (int row = 0; row < rows_used; ++row) {
+        const int column = star_in_row[row];
+        if (column >= 0 && column < columns_used)
 #ifdef USE_STL
-                indexes.push_back(std::make_pair(row, column));
+            indexes.push_back(std::make_pair(row, column));
 #else
-                indexes.push_back(qMakePair(row, column));
+            indexes.push_back(qMakePair(row, column));
 #endif
-        }
     }
     return indexes;
 }
 
 
-KuhnMunkres::Dimensions KuhnMunkres::ensure_grid_is_square()
+// Copies the grid into the aligned buffer, padding it to be square with
+// DBL_MIN (and each row to the stride with zeros); the buffer also
+// holds three more stride-long rows for the column mask and offsets
+void KuhnMunkres::copy_grid(const Grid &grid, int *rows_used,
+                            int *columns_used)
 {
-    int max_columns = 0;
-    int total_rows = grid_.size();
-    for (int row = 0; row < total_rows; ++row)
-        max_columns = std::max(max_columns,
-                               static_cast<int>(grid_.at(row).size()));
-    total_rows = std::max(total_rows, max_columns);
-    const int rows_used = grid_.size();
-    const int columns_used = max_columns;
-
-    Grid new_grid;
-    for (int row = 0; row < static_cast<int>(grid_.size()); ++row) {
-        Row new_row(grid_.at(row));
-#ifdef USE_STL
-        new_row.resize(total_rows, DBL_MIN);
-#else
-        // QVector::fill() is _not_ the same as std::vector::resize()!
-        new_row.reserve(total_rows);
-        while (new_row.size() < total_rows)
-            new_row.push_back(DBL_MIN);
-#endif
-        new_grid.push_back(new_row);
+    *rows_used = static_cast<int>(grid.size());
+    *columns_used = 0;
+    for (int row = 0; row < *rows_used; ++row)
+        *columns_used = std::max(*columns_used,
+                                 static_cast<int>(grid.at(row).size()));
+    size = std::max(*rows_used, *columns_used);
+    stride = ((size + BlockSize - 1) / BlockSize) * BlockSize;
+
+    storage.assign(((size + 3) * stride) + BlockSize, 0.0);
+    const std::size_t address = reinterpret_cast<std::size_t>(
+            &storage[0]);
+    base = ((Alignment - (address % Alignment)) % Alignment) /
+           sizeof(double);
+    for (int row = 0; row < size; ++row) {
+        double *costs = cost_row(row);
+        int column = 0;
+        if (row < *rows_used) {
+            const Row &source = grid.at(row);
+            for (; column < static_cast<int>(source.size()); ++column)
+                costs[column] = source.at(column);
+        }
+        std::fill(costs + column, costs + size, DBL_MIN);
     }
-
-    while (static_cast<int>(new_grid.size()) < total_rows)
-        new_grid.push_back(Row(total_rows, DBL_MIN));
-
-    grid_ = new_grid;
-#ifdef USE_STL
-    return std::make_pair(rows_used, columns_used);
-#else
-    return qMakePair(rows_used, columns_used);
-#endif
 }
 
 
-template<typename T>
-#ifdef USE_STL
-std::vector<std::vector<T> >
-#else
-QVector<QVector<T> >
-#endif
-KuhnMunkres::make_grid(int size, T value)
+// Sets the column mask to 0 for uncovered columns and infinity for
+// covered ones (and the padding)
+void KuhnMunkres::update_column_mask()
 {
-#ifdef USE_STL
-    std::vector<std::vector<T> > grid;
-    grid.resize(size, std::vector<T>());
-#else
-    QVector<QVector<T> > grid;
-    grid.fill(QVector<T>(), size);
-#endif
-    for (int row = 0; row < size; ++row)
-#ifdef USE_STL
-        grid[row].resize(size, value);
-#else
-        grid[row].fill(value, size);
-#endif
-    return grid;
+    double *mask = column_mask();
+    for (int column = 0; column < size; ++column)
+        mask[column] = column_covered.test(column) ? Infinity : 0.0;
+    std::fill(mask + size, mask + stride, Infinity);
 }
 
 
 int KuhnMunkres::step1()
 {
+    update_column_mask();
+    double *offsets = covered_row_offsets();
     for (int row = 0; row < size; ++row) {
-        double minimum = grid_.at(row).at(0);
-        for (int column = 1; column < size; ++column)
-            minimum = std::min(minimum, grid_.at(row).at(column));
-        for (int column = 0; column < size; ++column)
-            grid_[row][column] -= minimum;
+        double *costs = cost_row(row);
+        const double minimum = masked_minimum(costs, column_mask(),
+                                              stride);
+        std::fill(offsets, offsets + size, -minimum);
+        add_offsets(costs, offsets, stride);
     }
     return 2;
 }
@@ -143,12 +203,14 @@ int KuhnMunkres::step1()
 int KuhnMunkres::step2()
 {
     for (int row = 0; row < size; ++row) {
+        const double *costs = cost_row(row);
         for (int column = 0; column < size; ++column) {
-            if (is_zero(grid_.at(row).at(column)) &&
-                (!row_covered.at(row)) && (!column_covered.at(column))) {
-                marked[row][column] = STAR;
-                row_covered[row] = true;
-                column_covered[column] = true;
+            if (is_zero(costs[column]) && !column_covered.test(column)) {
+                star_in_row[row] = column;
+                star_in_column[column] = row;
+                row_covered.set(row);
+                column_covered.set(column);
+                break;
             }
         }
     }
@@ -160,12 +222,10 @@ int KuhnMunkres::step2()
 int KuhnMunkres::step3()
 {
     int count = 0;
-    for (int row = 0; row < size; ++row) {
-        for (int column = 0; column < size; ++column) {
-            if (marked.at(row).at(column) == STAR) {
-                column_covered[column] = true;
-                ++count;
-            }
+    for (int column = 0; column < size; ++column) {
+        if (star_in_column[column] >= 0) {
+            column_covered.set(column);
+            ++count;
         }
     }
     return (count >= size) ? 0 : 4;
@@ -179,21 +239,21 @@ int KuhnMunkres::step4()
     int row = -1;
     int column = -1;
     int star_column = -1;
+    update_column_mask();
+    zero_in_row.assign(size, -1);
+    rows_scanned = 0;
     while (!done) {
-        Index index = find_a_zero();
-        row = index.first;
-        column = index.second;
-        if (row < 0) {
+        if (!find_a_zero(&row, &column)) {
             done = true;
             step = 6;
         }
         else {
-            marked[row][column] = PRIME;
+            prime_in_row[row] = column;
             star_column = find_star_in_row(row);
             if (star_column >= 0) {
                 column = star_column;
-                row_covered[row] = true;
-                column_covered[column] = false;
+                row_covered.set(row);
+                uncover_column(column);
             }
             else {
                 done = true;
@@ -210,23 +270,23 @@ int KuhnMunkres::step4()
 int KuhnMunkres::step5()
 {
     int count = 0;
-    path[count][0] = z0_row;
-    path[count][1] = z0_column;
+    path[0] = z0_row;
+    path[1] = z0_column;
     bool done = false;
     while (!done) {
-        int row = find_star_in_column(path.at(count).at(1));
+        int row = find_star_in_column(path[(count * 2) + 1]);
         if (row >= 0) {
             ++count;
-            path[count][0] = row;
-            path[count][1] = path.at(count - 1).at(1);
+            path[count * 2] = row;
+            path[(count * 2) + 1] = path[((count - 1) * 2) + 1];
         }
         else
             done = true;
         if (!done) {
-            int column = find_prime_in_row(path.at(count).at(0));
+            int column = find_prime_in_row(path[count * 2]);
             ++count;
-            path[count][0] = path.at(count - 1).at(0);
-            path[count][1] = column;
+            path[count * 2] = path[(count - 1) * 2];
+            path[(count * 2) + 1] = column;
         }
     }
     convert_path(count);
@@ -236,131 +296,127 @@ int KuhnMunkres::step5()
 }
 
 
+// Adds the minimum to every element of each covered row and subtracts
+// it from every element of each uncovered column, i.e., adds it to the
+// covered columns of covered rows and subtracts it from the uncovered
+// columns of uncovered rows, using one precomputed row of offsets for
+// each kind of row
 int KuhnMunkres::step6()
 {
-    double minimum = find_smallest();
-    for (int row = 0; row < size; ++row) {
-        for (int column = 0; column < size; ++column) {
-            if (row_covered.at(row))
-                grid_[row][column] += minimum;
-            if (!column_covered.at(column))
-                grid_[row][column] -= minimum;
-        }
+    const double minimum = find_smallest();
+    double *covered_offsets = covered_row_offsets();
+    double *uncovered_offsets = uncovered_row_offsets();
+    for (int column = 0; column < size; ++column) {
+        const bool covered = column_covered.test(column);
+        covered_offsets[column] = covered ? minimum : 0.0;
+        uncovered_offsets[column] = covered ? 0.0 : -minimum;
     }
+    for (int row = 0; row < size; ++row)
+        add_offsets(cost_row(row), row_covered.test(row)
+                    ? covered_offsets : uncovered_offsets, stride);
     return 4;
 }
 
 
 void KuhnMunkres::clear_covers()
 {
-#ifdef USE_STL
-    row_covered.assign(size, false);
-    column_covered.assign(size, false);
-#else
-    row_covered.fill(false, size);
-    column_covered.fill(false, size);
-#endif
+    row_covered.clear();
+    column_covered.clear();
 }
 
 
-KuhnMunkres::Index KuhnMunkres::find_a_zero()
+// Within step4() the costs don't change, rows only get covered and
+// columns only get uncovered, so a row that has been scanned and found
+// to have no uncovered zero can only gain one in a column that's
+// uncovered later. So those columns are checked for the rows scanned so
+// far (noting each row's last such zero), rather than rescanning them.
+void KuhnMunkres::uncover_column(int column)
 {
-    int row = -1;
-    int column = -1;
-    int i = 0;
-    bool done = false;
-    while (!done) {
-        int j = 0;
-        while (true) {
-            if (is_zero(grid_.at(i).at(j)) &&
-                (!row_covered.at(i)) && (!column_covered.at(j))) {
-                row = i;
-                column = j;
-                done = true;
-            }
-            ++j;
-            if (j >= size)
-                break;
+    column_covered.reset(column);
+    column_mask()[column] = 0.0;
+    for (int row = 0; row < rows_scanned; ++row) {
+        if (!row_covered.test(row) && is_zero(cost_row(row)[column]))
+            zero_in_row[row] = std::max(zero_in_row[row], column);
+    }
+}
+
+
+// Finds the last uncovered zero in the first row that has one; only
+// rows that haven't been scanned during this step4() are scanned
+bool KuhnMunkres::find_a_zero(int *row, int *column)
+{
+    for (int i = 0; i < rows_scanned; ++i) {
+        if (zero_in_row[i] >= 0 && !row_covered.test(i)) {
+            *row = i;
+            *column = zero_in_row[i];
+            return true;
         }
-        ++i;
-        if (i >= size)
-            done = true;
     }
-#ifdef USE_STL
-    return std::make_pair(row, column);
-#else
-    return qMakePair(row, column);
-#endif
+    for (; rows_scanned < size; ++rows_scanned) {
+        const int i = rows_scanned;
+        if (row_covered.test(i))
+            continue;
+        const int j = last_zero(cost_row(i), column_mask(), stride);
+        if (j >= 0) {
+            ++rows_scanned;
+            *row = i;
+            *column = j;
+            return true;
+        }
+    }
+    *row = -1;
+    *column = -1;
+    return false;
 }
 
 
 int KuhnMunkres::find_star_in_row(int row)
 {
-    int column = -1;
-    for (int j = 0; j < size; ++j)
-        if (marked.at(row).at(j) == STAR) {
-            column = j;
-            break;
-        }
-    return column;
+    return star_in_row[row];
 }
 
 
 int KuhnMunkres::find_star_in_column(int column)
 {
-    int row = -1;
-    for (int i = 0; i < size; ++i)
-        if (marked.at(i).at(column) == STAR) {
-            row = i;
-            break;
-        }
-    return row;
+    return star_in_column[column];
 }
 
 
 int KuhnMunkres::find_prime_in_row(int row)
 {
-    int column = -1;
-    for (int j = 0; j < size; ++j)
-        if (marked.at(row).at(j) == PRIME) {
-            column = j;
-            break;
-        }
-    return column;
+    return prime_in_row[row];
 }
 
 
+// The path alternates primed and starred zeros, starting and ending
+// with primed ones; its stars are unstarred and its primes starred
 void KuhnMunkres::convert_path(int count)
 {
-    for (int i = 0; i <= count; ++i) {
-        int &x = marked[path.at(i).at(0)][path.at(i).at(1)];
-        x = (x == STAR ? ZERO : STAR);
+    for (int i = 1; i <= count; i += 2) {
+        star_in_row[path[i * 2]] = -1;
+        star_in_column[path[(i * 2) + 1]] = -1;
+    }
+    for (int i = 0; i <= count; i += 2) {
+        star_in_row[path[i * 2]] = path[(i * 2) + 1];
+        star_in_column[path[(i * 2) + 1]] = path[i * 2];
     }
 }
 
 
 void KuhnMunkres::erase_primes()
 {
-    for (int row = 0; row < size; ++row) {
-        for (int column = 0; column < size; ++column) {
-            int &x = marked[row][column];
-            if (x == PRIME)
-                x = ZERO;
-        }
-
-    }
+    prime_in_row.assign(size, -1);
 }
 
 
 double KuhnMunkres::find_smallest()
 {
+    update_column_mask();
     double minimum = DBL_MAX;
     for (int row = 0; row < size; ++row) {
-        for (int column = 0; column < size; ++column)
-            if ((!row_covered.at(row)) && (!column_covered.at(column))) {
-                if (minimum > grid_.at(row).at(column))
-                    minimum = grid_[row][column];
-            }
+        if (!row_covered.test(row))
+            minimum = std::min(minimum, masked_minimum(cost_row(row),
+                                        column_mask(), stride));
     }
     return minimum;
 }
@@ -18,15 +18,26 @@
 */
 
 #include <cfloat>
+#include <climits>
 #include <cmath>
-#ifdef USE_STL
+#include <cstddef>
 #include <vector>
-#else
+#ifndef USE_STL
 #include <QPair>
 #include <QVector>
 #endif
 
 
+// The Grid type is only used to pass in the costs: they're copied into
+// a single buffer of rows that start on 64 byte boundaries (each row is
+// stride doubles long, the columns beyond the grid's size being padding
+// that's never a minimum), so the row minimum and add/subtract passes
+// can work on whole aligned blocks, using SSE2 where it's available.
+// The row and column covers are bitsets, and since a row or column
+// never has more than one starred zero (or a row more than one primed
+// zero) these are kept as the column or row of each rather than as a
+// grid of marks.
+
 class KuhnMunkres
 {
 public:
@@ -42,32 +53,41 @@ public:
     typedef QVector<Row> Grid;
 #endif
 
-    explicit KuhnMunkres() {}
+    explicit KuhnMunkres()
+        : size(0), stride(0), base(0), rows_scanned(0) {}
 
     Indexes calculate(const Grid &grid);
 
     static bool is_zero(double x) { return std::fabs(x) <= DBL_EPSILON; }
 
 private:
-#ifdef USE_STL
-    typedef std::pair<int, int> Dimensions;
-    typedef std::vector<int> IntRow;
-    typedef std::vector<IntRow> IntGrid;
-#else
-    typedef QPair<int, int> Dimensions;
-    typedef QVector<int> IntRow;
-    typedef QVector<IntRow> IntGrid;
-#endif
+    class Bits
+    {
+    public:
+        void resize(int count)
+            { words.assign((count + WordBits - 1) / WordBits, 0); }
+        bool test(int i) const
+            { return (words[i / WordBits] >> (i % WordBits)) & 1; }
+        void set(int i) { words[i / WordBits] |= 1UL << (i % WordBits); }
+        void reset(int i)
+            { words[i / WordBits] &= ~(1UL << (i % WordBits)); }
+        void clear() { words.assign(words.size(), 0); }
 
-    enum {ZERO, STAR, PRIME};
+    private:
+        enum {WordBits = sizeof(unsigned long) * CHAR_BIT};
 
-    Dimensions ensure_grid_is_square();
-    template<typename T>
-#ifdef USE_STL
-    std::vector<std::vector<T> > make_grid(int size, T value);
-#else
-    QVector<QVector<T> > make_grid(int size, T value);
-#endif
+        std::vector<unsigned long> words;
+    };
+
+    KuhnMunkres(const KuhnMunkres&);
+    KuhnMunkres &operator=(const KuhnMunkres&);
+
+    void copy_grid(const Grid &grid, int *rows_used, int *columns_used);
+    double *cost_row(int row) { return &storage[base + (row * stride)]; }
+    double *column_mask() { return cost_row(size); }
+    double *covered_row_offsets() { return cost_row(size + 1); }
+    double *uncovered_row_offsets() { return cost_row(size + 2); }
+    void update_column_mask();
     int step1();
     int step2();
     int step3();
@@ -75,7 +95,8 @@ private:
     int step5();
     int step6();
     void clear_covers();
-    Index find_a_zero();
+    void uncover_column(int column);
+    bool find_a_zero(int *row, int *column);
     int find_star_in_row(int row);
     int find_star_in_column(int column);
     int find_prime_in_row(int row);
@@ -83,19 +104,20 @@ private:
     void erase_primes();
     double find_smallest();
 
-    Grid grid_;
-#ifdef USE_STL
-    std::vector<bool> row_covered;
-    std::vector<bool> column_covered;
-#else
-    QVector<bool> row_covered;
-    QVector<bool> column_covered;
-#endif
+    int size;
+    int stride;
+    std::size_t base; // Index of the first aligned double in storage
+    std::vector<double> storage;
+    std::vector<int> star_in_row; // Column of each row's star or -1
+    std::vector<int> star_in_column; // Row of each column's star or -1
+    std::vector<int> prime_in_row; // Column of each row's prime or -1
+    std::vector<int> path; // (row, column) pairs
+    Bits row_covered;
+    Bits column_covered;
+    std::vector<int> zero_in_row; // Only used by step4()
+    int rows_scanned; // Only used by step4()
     int z0_row;
     int z0_column;
-    IntGrid path;
-    IntGrid marked;
-    int size;
 };
 
 #endif // KUHN_MUNKRES_HPP
@@ -0,0 +1,152 @@
+/*
+    Copyright (c) 2008-10 Qtrac Ltd. All rights reserved.
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 2 of
+    the License, or version 3 of the License, or (at your option) any
+    later version. This program is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+    See the GNU General Public License for more details.
+*/
+
+#include "shortest_augmenting_path.hpp"
+#include <algorithm>
+#include <utility>
+
+
+ShortestAugmentingPath::Indexes ShortestAugmentingPath::calculate(
+        const Grid &grid)
+{
+    const int rows_used = static_cast<int>(grid.size());
+    int columns_used = 0;
+    for (int row = 0; row < rows_used; ++row)
+        columns_used = std::max(columns_used,
+                                static_cast<int>(grid.at(row).size()));
+    const bool transpose = rows_used > columns_used;
+    copy_grid(grid, columns_used, transpose);
+
+    // Column 0 is a sentinel that each search starts from, so the real
+    // columns are 1..columns, and row_for_column holds row + 1 (0 means
+    // unassigned)
+#ifdef USE_STL
+    row_potential.assign(rows + 1, 0.0);
+    column_potential.assign(columns + 1, 0.0);
+    row_for_column.assign(columns + 1, 0);
+    previous_column.assign(columns + 1, 0);
+#else
+    row_potential.fill(0.0, rows + 1);
+    column_potential.fill(0.0, columns + 1);
+    row_for_column.fill(0, columns + 1);
+    previous_column.fill(0, columns + 1);
+#endif
+    for (int row = 0; row < rows; ++row)
+        assign_row(row);
+
+    IntRow column_for_row(transpose ? columns : rows, -1);
+    for (int column = 1; column <= columns; ++column) {
+        const int row = row_for_column.at(column) - 1;
+        if (row < 0)
+            continue;
+        if (transpose)
+            column_for_row[column - 1] = row;
+        else
+            column_for_row[row] = column - 1;
+    }
+    Indexes indexes;
+    for (int row = 0; row < static_cast<int>(column_for_row.size());
+         ++row) {
+        if (column_for_row.at(row) >= 0)
+#ifdef USE_STL
+            indexes.push_back(std::make_pair(row, column_for_row.at(row)));
+#else
+            indexes.push_back(qMakePair(row, column_for_row.at(row)));
+#endif
+    }
+    return indexes;
+}
+
+
+void ShortestAugmentingPath::copy_grid(const Grid &grid,
+                                       int columns_used, bool transpose)
+{
+    const int rows_used = static_cast<int>(grid.size());
+    rows = transpose ? columns_used : rows_used;
+    columns = transpose ? rows_used : columns_used;
+#ifdef USE_STL
+    costs.assign(rows * columns, DBL_MIN);
+#else
+    costs.fill(DBL_MIN, rows * columns);
+#endif
+    double *data = costs.empty() ? 0 : &costs[0];
+    for (int row = 0; row < rows_used; ++row) {
+        const Row &grid_row = grid.at(row);
+        for (int column = 0; column < static_cast<int>(grid_row.size());
+             ++column) {
+            if (transpose)
+                data[(column * columns) + row] = grid_row.at(column);
+            else
+                data[(row * columns) + column] = grid_row.at(column);
+        }
+    }
+}
+
+
+// Finds the shortest path (in reduced costs) from the row to an
+// unassigned column and flips the assignments along it
+void ShortestAugmentingPath::assign_row(int row)
+{
+#ifdef USE_STL
+    shortest.assign(columns + 1, DBL_MAX);
+    visited.assign(columns + 1, 0);
+#else
+    shortest.fill(DBL_MAX, columns + 1);
+    visited.fill(0, columns + 1);
+#endif
+    double *u = &row_potential[0];
+    double *v = &column_potential[0];
+    double *distance = &shortest[0];
+    int *row_of = &row_for_column[0];
+    int *previous = &previous_column[0];
+    int *seen = &visited[0];
+    const double *data = &costs[0];
+
+    row_of[0] = row + 1;
+    int column0 = 0;
+    do {
+        seen[column0] = 1;
+        const int row0 = row_of[column0];
+        const double *row_costs = data + ((row0 - 1) * columns) - 1;
+        double delta = DBL_MAX;
+        int column1 = 0;
+        for (int column = 1; column <= columns; ++column) {
+            if (seen[column])
+                continue;
+            const double reduced = row_costs[column] - u[row0] -
+                                   v[column];
+            if (reduced < distance[column]) {
+                distance[column] = reduced;
+                previous[column] = column0;
+            }
+            if (distance[column] < delta) {
+                delta = distance[column];
+                column1 = column;
+            }
+        }
+        for (int column = 0; column <= columns; ++column) {
+            if (seen[column]) {
+                u[row_of[column]] += delta;
+                v[column] -= delta;
+            }
+            else
+                distance[column] -= delta;
+        }
+        column0 = column1;
+    } while (row_of[column0] != 0);
+
+    do {
+        const int column1 = previous[column0];
+        row_of[column0] = row_of[column1];
+        column0 = column1;
+    } while (column0);
+}
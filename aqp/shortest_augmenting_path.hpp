@@ -0,0 +1,65 @@
+#ifndef SHORTEST_AUGMENTING_PATH_HPP
+#define SHORTEST_AUGMENTING_PATH_HPP
+
+/*
+    Copyright (c) 2008-10 Qtrac Ltd. All rights reserved.
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 2 of
+    the License, or version 3 of the License, or (at your option) any
+    later version. This program is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+    See the GNU General Public License for more details.
+
+    This solves the same minimum cost assignment problem as KuhnMunkres
+    (and takes and returns the same types) using the shortest augmenting
+    path method of Jonker and Volgenant: rows are assigned one at a
+    time, each by a Dijkstra-style search over the columns using
+    reduced costs kept non-negative by row and column potentials. This
+    takes O(n^2 m) time for n rows and m >= n columns (the grid is
+    transposed if there are more rows than columns), rather than the
+    roughly O(n^4) of the six step method, so it is the one to use for
+    big grids.
+
+    As with KuhnMunkres, short rows are treated as if padded with
+    DBL_MIN, and the indexes are returned in row order.
+*/
+
+#include "kuhn_munkres.hpp"
+
+
+class ShortestAugmentingPath
+{
+public:
+    typedef KuhnMunkres::Index Index;
+    typedef KuhnMunkres::Indexes Indexes;
+    typedef KuhnMunkres::Row Row;
+    typedef KuhnMunkres::Grid Grid;
+
+    explicit ShortestAugmentingPath() {}
+
+    Indexes calculate(const Grid &grid);
+
+private:
+#ifdef USE_STL
+    typedef std::vector<int> IntRow;
+#else
+    typedef QVector<int> IntRow;
+#endif
+
+    void copy_grid(const Grid &grid, int columns_used, bool transpose);
+    void assign_row(int row);
+
+    int rows;
+    int columns;
+    Row costs; // rows x columns, row-major
+    Row row_potential;
+    Row column_potential;
+    Row shortest;
+    IntRow row_for_column;
+    IntRow previous_column;
+    IntRow visited; // ints rather than bools so they're addressable
+};
+
+#endif // SHORTEST_AUGMENTING_PATH_HPP
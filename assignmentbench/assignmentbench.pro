@@ -0,0 +1,11 @@
+CONFIG	    += console release
+CONFIG	    -= app_bundle
+HEADERS	    += ../aqp/kuhn_munkres.hpp
+SOURCES	    += ../aqp/kuhn_munkres.cpp
+HEADERS	    += ../aqp/shortest_augmenting_path.hpp
+SOURCES	    += ../aqp/shortest_augmenting_path.cpp
+INCLUDEPATH += ../aqp
+HEADERS	    += ../option_parser/option_parser.hpp
+SOURCES	    += ../option_parser/option_parser.cpp
+INCLUDEPATH += ../option_parser
+SOURCES	    += main.cpp
@@ -0,0 +1,217 @@
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include "kuhn_munkres.hpp"
+#include "option_parser.hpp"
+#include "shortest_augmenting_path.hpp"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
+
+namespace {
+
+typedef KuhnMunkres::Grid Grid;
+typedef KuhnMunkres::Row Row;
+typedef KuhnMunkres::Indexes Indexes;
+
+
+// Ragged grids have rows of random lengths (as short rows are allowed)
+Grid randomGrid(int rows, int columns, int maximumCost, bool ragged,
+                bool negative)
+{
+    Grid grid;
+    for (int row = 0; row < rows; ++row) {
+        Row rowData;
+        const int length = ragged ? qrand() % (columns + 1) : columns;
+        for (int column = 0; column < length; ++column) {
+            int cost = qrand() % (maximumCost + 1);
+            if (negative)
+                cost -= maximumCost / 2;
+            rowData.push_back(cost);
+        }
+        grid.push_back(rowData);
+    }
+    return grid;
+}
+
+
+int columnsIn(const Grid &grid)
+{
+    int columns = 0;
+    for (int row = 0; row < static_cast<int>(grid.size()); ++row)
+        columns = qMax(columns, static_cast<int>(grid.at(row).size()));
+    return columns;
+}
+
+
+// Checks that the indexes are a complete assignment in row order with
+// no row or column used twice, and if so sets the total cost
+bool isValidAssignment(const Grid &grid, const Indexes &indexes,
+                       double *total)
+{
+    const int rows = static_cast<int>(grid.size());
+    const int columns = columnsIn(grid);
+    if (static_cast<int>(indexes.size()) != qMin(rows, columns))
+        return false;
+    QVector<bool> columnUsed(columns, false);
+    int previousRow = -1;
+    *total = 0.0;
+    for (int i = 0; i < static_cast<int>(indexes.size()); ++i) {
+        const int row = indexes.at(i).first;
+        const int column = indexes.at(i).second;
+        if (row <= previousRow || row >= rows || column < 0 ||
+            column >= columns || columnUsed.at(column))
+            return false;
+        previousRow = row;
+        columnUsed[column] = true;
+        const Row &rowData = grid.at(row);
+        *total += column < static_cast<int>(rowData.size())
+                  ? rowData.at(column) : DBL_MIN;
+    }
+    return true;
+}
+
+
+// Both must give valid assignments with the same (minimum) total; the
+// actual pairs may differ when there's more than one optimum
+bool solversAgree(const Grid &grid)
+{
+    KuhnMunkres kuhnMunkres;
+    ShortestAugmentingPath shortestAugmentingPath;
+    double expected;
+    double actual;
+    return isValidAssignment(grid, kuhnMunkres.calculate(grid),
+                             &expected) &&
+           isValidAssignment(grid,
+                             shortestAugmentingPath.calculate(grid),
+                             &actual) &&
+           qAbs(expected - actual) <= 1e-6;
+}
+
+
+template<typename Solver>
+double timeMSec(const Grid &grid, double *total)
+{
+    Solver solver;
+    QElapsedTimer timer;
+    timer.start();
+    const Indexes indexes = solver.calculate(grid);
+    const double msec = timer.nsecsElapsed() / 1000000.0;
+    if (!isValidAssignment(grid, indexes, total))
+        *total = -1.0;
+    return msec;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    AQP::OptionParser parser(app.arguments(),
+            "usage: {program} [options]\n"
+            "\nTimes the KuhnMunkres and ShortestAugmentingPath "
+            "assignment solvers on random\nsquare grids of each size "
+            "and checks that they find assignments with\nthe same "
+            "total cost, both on those and on lots of small random "
+            "grids\n(including rectangular, ragged and negative cost "
+            "ones).\n",
+            "\nCopyright (c) 2009-10 Qtrac Ltd. All rights reserved.");
+    AQP::StringOptionPtr sizesOpt = parser.addStringOption("n",
+                                                           "sizes");
+    sizesOpt->setHelp("comma-separated grid sizes");
+    sizesOpt->setDefaultValue("500,1000,2000");
+    // KuhnMunkres takes over a minute at 5000 so larger sizes are opt-in
+    AQP::IntegerOptionPtr limitOpt = parser.addIntegerOption("k",
+            "kuhn-munkres-limit");
+    limitOpt->setHelp("largest size to run KuhnMunkres on");
+    limitOpt->setDefaultValue(1000);
+    limitOpt->setMinimum(0);
+    AQP::IntegerOptionPtr maximumOpt = parser.addIntegerOption("m",
+            "maximum");
+    maximumOpt->setHelp("maximum cost");
+    maximumOpt->setDefaultValue(1000);
+    maximumOpt->setMinimum(1);
+    AQP::IntegerOptionPtr validateOpt = parser.addIntegerOption("v",
+            "validate");
+    validateOpt->setHelp("number of small grids to cross-validate");
+    validateOpt->setDefaultValue(2000);
+    validateOpt->setMinimum(0);
+    AQP::IntegerOptionPtr seedOpt = parser.addIntegerOption("s",
+                                                            "seed");
+    seedOpt->setHelp("random number seed");
+    seedOpt->setDefaultValue(1);
+    if (!parser.parse())
+        return 2;
+
+    QList<int> sizes;
+    foreach (const QString &size,
+             sizesOpt->value().split(",", QString::SkipEmptyParts)) {
+        bool ok;
+        sizes << size.trimmed().toInt(&ok);
+        if (!ok || sizes.last() < 1) {
+            err << "invalid size: " << size << "\n";
+            return 2;
+        }
+    }
+    qsrand(static_cast<uint>(seedOpt->value()));
+
+    int failures = 0;
+    for (int i = 0; i < validateOpt->value(); ++i) {
+        const int rows = qrand() % 13;
+        const int columns = i % 3 ? qrand() % 13 : rows;
+        const Grid grid = randomGrid(rows, columns, 20, i % 5 == 0,
+                                     i % 2);
+        if (!solversAgree(grid)) {
+            if (++failures == 1)
+                err << "first disagreement on small grid " << i << " ("
+                    << rows << "x" << columnsIn(grid) << ")\n";
+        }
+    }
+    if (validateOpt->value())
+        out << "cross-validated " << validateOpt->value()
+            << " small grids: " << failures << " disagreements\n";
+
+    out << "size  shortest augmenting path  Kuhn-Munkres\n";
+    foreach (const int size, sizes) {
+        const Grid grid = randomGrid(size, size, maximumOpt->value(),
+                                     false, false);
+        double total;
+        const double msec = timeMSec<ShortestAugmentingPath>(grid,
+                                                             &total);
+        out << QString("%1  %2 ms").arg(size, 4)
+               .arg(msec, 20, 'f', 1);
+        if (total < 0.0) {
+            out << "  (invalid assignment)";
+            ++failures;
+        }
+        if (size <= limitOpt->value()) {
+            double expected;
+            const double kuhnMunkresMSec = timeMSec<KuhnMunkres>(grid,
+                    &expected);
+            out << QString("  %1 ms").arg(kuhnMunkresMSec, 9, 'f', 1);
+            if (expected < 0.0 || qAbs(expected - total) > 1e-6) {
+                out << "  (totals differ)";
+                ++failures;
+            }
+        }
+        out << "\n";
+        out.flush();
+    }
+    return failures ? 1 : 0;
+}
@@ -48,30 +48,152 @@ CensusVisualizer::CensusVisualizer(QWidget *parent)
 
 void CensusVisualizer::setModel(QAbstractItemModel *model)
 {
-    if (model) {
-        QLocale locale;
-        for (int row = 0; row < model->rowCount(); ++row) {
-            int total = locale.toInt(model->data(
-                                model->index(row, Total)).toString());
-            if (total > m_maximumPopulation)
-                m_maximumPopulation = total;
-        }
-        QString population = QString::number(m_maximumPopulation);
-        population = QString("%1%2")
-                .arg(population.left(1).toInt() + 1)
-                .arg(QString(population.length() - 1, QChar('0')));
-        m_maximumPopulation = population.toInt();
-        QFontMetrics fm(font());
-        m_widthOfTotalColumn = fm.width(QString("W%1%2W")
-                .arg(population)
-                .arg(QString(population.length() / 3, ',')));
-    }
+    if (m_model)
+        disconnect(m_model, 0, this, 0);
     m_model = model;
+    if (m_model) {
+        connect(m_model,
+                SIGNAL(dataChanged(const QModelIndex&,
+                                   const QModelIndex&)),
+                this, SLOT(dataChanged(const QModelIndex&,
+                                       const QModelIndex&)));
+        connect(m_model,
+                SIGNAL(rowsInserted(const QModelIndex&, int, int)),
+                this, SLOT(rowsInserted(const QModelIndex&, int, int)));
+        connect(m_model,
+                SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
+                this, SLOT(rowsRemoved(const QModelIndex&, int, int)));
+        connect(m_model, SIGNAL(modelReset()), this, SLOT(readTotals()));
+        connect(m_model, SIGNAL(layoutChanged()),
+                this, SLOT(readTotals()));
+    }
+    readTotals();
     header->update();
     view->update();
 }
 
 
+// Numbers are used as-is; but if the data is stored as _strings_
+// QLocale is needed because they have locale-specific separators,
+// e.g., 8.392.419 or 8,392,419.
+int CensusVisualizer::population(int row, int column) const
+{
+    const QVariant value = m_model->data(m_model->index(row, column),
+                                         Qt::EditRole);
+    if (value.type() == QVariant::String)
+        return QLocale().toInt(value.toString());
+    return value.toInt();
+}
+
+
+void CensusVisualizer::readTotals()
+{
+    totalForRow.clear();
+    rowCountForTotal.clear();
+    if (m_model) {
+        const int rows = m_model->rowCount();
+        totalForRow.fill(0, rows);
+        if (rows)
+            rowCountForTotal[0] = rows;
+        for (int row = 0; row < rows; ++row)
+            setTotal(row, population(row, Total));
+    }
+    updateScale();
+    updateViewSize();
+}
+
+
+void CensusVisualizer::setTotal(int row, int total)
+{
+    const int oldTotal = totalForRow.at(row);
+    if (total == oldTotal)
+        return;
+    QMap<int, int>::iterator i = rowCountForTotal.find(oldTotal);
+    if (--i.value() == 0)
+        rowCountForTotal.erase(i);
+    ++rowCountForTotal[total];
+    totalForRow[row] = total;
+}
+
+
+void CensusVisualizer::dataChanged(const QModelIndex &topLeft,
+                                   const QModelIndex &bottomRight)
+{
+    if (topLeft.parent().isValid())
+        return;
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        if (topLeft.column() <= Total && bottomRight.column() >= Total)
+            setTotal(row, population(row, Total));
+        view->updateRow(row);
+    }
+    updateScale();
+}
+
+
+void CensusVisualizer::rowsInserted(const QModelIndex &parent,
+                                    int start, int end)
+{
+    if (parent.isValid())
+        return;
+    const int count = end - start + 1;
+    totalForRow.insert(start, count, 0);
+    rowCountForTotal[0] += count;
+    for (int row = start; row <= end; ++row)
+        setTotal(row, population(row, Total));
+    updateScale();
+    updateViewSize();
+}
+
+
+void CensusVisualizer::rowsRemoved(const QModelIndex &parent,
+                                   int start, int end)
+{
+    if (parent.isValid())
+        return;
+    for (int row = start; row <= end; ++row)
+        setTotal(row, 0);
+    const int count = end - start + 1;
+    QMap<int, int>::iterator i = rowCountForTotal.find(0);
+    if ((i.value() -= count) == 0)
+        rowCountForTotal.erase(i);
+    totalForRow.remove(start, count);
+    updateScale();
+    updateViewSize();
+}
+
+
+// The scale's maximum is the largest total rounded up to the next
+// leading digit, e.g., 7,355,000 becomes 8,000,000, so it (and the
+// strips the view has cached) only changes when the largest total
+// crosses such a boundary.
+void CensusVisualizer::updateScale()
+{
+    const int largest = rowCountForTotal.isEmpty()
+                        ? 0 : rowCountForTotal.lastKey();
+    QString population = QString::number(largest);
+    population = QString("%1%2")
+            .arg(population.left(1).toInt() + 1)
+            .arg(QString(population.length() - 1, QChar('0')));
+    const int maximumPopulation = population.toInt();
+    if (maximumPopulation == m_maximumPopulation)
+        return;
+    m_maximumPopulation = maximumPopulation;
+    QFontMetrics fm(font());
+    m_widthOfTotalColumn = fm.width(QString("W%1%2W")
+            .arg(population)
+            .arg(QString(population.length() / 3, ',')));
+    header->update();
+    view->update();
+}
+
+
+void CensusVisualizer::updateViewSize()
+{
+    view->resize(view->width(), view->sizeHint().height());
+    view->update();
+}
+
+
 int CensusVisualizer::widthOfMaleFemaleColumn() const
 {
     return width() - (m_widthOfYearColumn +
@@ -80,17 +202,24 @@ int CensusVisualizer::widthOfMaleFemaleColumn() const
 }
 
 
+// Only the rows that were and are now selected need repainting
 void CensusVisualizer::setSelectedRow(int row)
 {
+    if (row == m_selectedRow)
+        return;
+    view->updateRow(m_selectedRow);
     m_selectedRow = row;
-    view->update();
+    view->updateRow(m_selectedRow);
 }
 
 
 void CensusVisualizer::setSelectedColumn(int column)
 {
+    if (column == m_selectedColumn)
+        return;
     m_selectedColumn = column;
     header->update();
+    view->updateRow(m_selectedRow);
 }
 
 
@@ -13,6 +13,8 @@
     the GNU General Public License for more details.
 */
 
+#include <QMap>
+#include <QVector>
 #include <QWidget>
 
 
@@ -29,6 +31,12 @@ const int Invalid = -1;
 enum {Year, Males, Females, Total};
 
 
+// The scale is based on the largest total population. Every row's
+// total is kept along with a count of how many rows have each total,
+// so when rows are edited, inserted or removed the largest total is
+// kept up to date in O(log n) without rescanning the model.
+
+
 class CensusVisualizer : public QWidget
 {
     Q_OBJECT
@@ -40,6 +48,7 @@ public:
     void setModel(QAbstractItemModel *model);
     QScrollArea *scrollArea() const { return m_scrollArea; }
     int maximumPopulation() const { return m_maximumPopulation; }
+    int population(int row, int column) const;
     int widthOfYearColumn() const { return m_widthOfYearColumn; }
     int widthOfMaleFemaleColumn() const;
     int widthOfTotalColumn() const { return m_widthOfTotalColumn; }
@@ -61,7 +70,18 @@ public slots:
 signals:
     void clicked(const QModelIndex&);
 
+private slots:
+    void dataChanged(const QModelIndex &topLeft,
+                     const QModelIndex &bottomRight);
+    void rowsInserted(const QModelIndex &parent, int start, int end);
+    void rowsRemoved(const QModelIndex &parent, int start, int end);
+    void readTotals();
+
 private:
+    void setTotal(int row, int total);
+    void updateScale();
+    void updateViewSize();
+
     QAbstractItemModel *m_model;
     QScrollArea *m_scrollArea;
 
@@ -73,6 +93,8 @@ private:
     int m_selectedRow;
     int m_selectedColumn;
     int m_maximumPopulation;
+    QVector<int> totalForRow;
+    QMap<int, int> rowCountForTotal;
 };
 
 #endif // CENSUSVISUALIZER_HPP
@@ -18,6 +18,7 @@
 #include <QLocale>
 #include <QPainter>
 #include <QPaintEvent>
+#include <QPixmapCache>
 #include <QScrollArea>
 #include <QScrollBar>
 
@@ -133,23 +134,38 @@ void CensusVisualizerView::keyPressEvent(QKeyEvent *event)
 }
 
 
+int CensusVisualizerView::rowHeight() const
+{
+    return static_cast<int>(QFontMetricsF(font()).height() +
+                            ExtraHeight);
+}
+
+
+void CensusVisualizerView::updateRow(int row)
+{
+    if (row == Invalid)
+        return;
+    const int RowHeight = rowHeight();
+    update(0, row * RowHeight, width(), RowHeight);
+}
+
+
 void CensusVisualizerView::paintEvent(QPaintEvent *event)
 {
     if (!visualizer->model())
         return;
-    QFontMetricsF fm(font());
-    const int RowHeight = fm.height() + ExtraHeight;
+    const int RowHeight = rowHeight();
     const int MinY = qMax(0, event->rect().y() - RowHeight);
     const int MaxY = MinY + event->rect().height() + RowHeight;
+    const QSize size(visualizer->widthOfYearColumn() +
+                     visualizer->widthOfMaleFemaleColumn() +
+                     visualizer->widthOfTotalColumn(), RowHeight);
 
     QPainter painter(this);
-    painter.setRenderHints(QPainter::Antialiasing|
-                           QPainter::TextAntialiasing);
-
     int row = MinY / RowHeight;
     int y = row * RowHeight;
     for (; row < visualizer->model()->rowCount(); ++row) {
-        paintRow(&painter, row, y, RowHeight);
+        painter.drawPixmap(0, y, rowStrip(row, size));
         y += RowHeight;
         if (y > MaxY)
             break;
@@ -157,6 +173,51 @@ void CensusVisualizerView::paintEvent(QPaintEvent *event)
 }
 
 
+QString CensusVisualizerView::cacheKeyForRow(int row,
+                                             const QSize &size) const
+{
+    QAbstractItemModel *model = visualizer->model();
+    // Males and Females are drawn the same way when either is selected
+    int selected = row == visualizer->selectedRow()
+                   ? visualizer->selectedColumn() : Invalid;
+    if (selected == Females)
+        selected = Males;
+    QString key = QString("CENSUSROW:%1x%2:%3:%4:%5:%6:%7:%8")
+            .arg(size.width()).arg(size.height())
+            .arg(visualizer->widthOfYearColumn())
+            .arg(visualizer->widthOfTotalColumn())
+            .arg(visualizer->maximumPopulation())
+            .arg(selected)
+            .arg(palette().cacheKey())
+            .arg(palette().currentColorGroup());
+    key += QString(":%1:%2").arg(devicePixelRatio()) //added for Qt5
+                            .arg(font().key());
+    for (int column = Year; column <= Total; ++column)
+        key += ":" + model->data(model->index(row, column)).toString();
+    return key;
+}
+
+
+QPixmap CensusVisualizerView::rowStrip(int row, const QSize &size)
+{
+    const QString key = cacheKeyForRow(row, size);
+    QPixmap pixmap;
+    if (!QPixmapCache::find(key, &pixmap)) {
+        pixmap = QPixmap(size * devicePixelRatio()); //added for Qt5
+        pixmap.setDevicePixelRatio(devicePixelRatio()); //added for Qt5
+        pixmap.fill(Qt::transparent);
+        QPainter painter(&pixmap);
+        painter.setFont(font());
+        painter.setRenderHints(QPainter::Antialiasing|
+                               QPainter::TextAntialiasing);
+        paintRow(&painter, row, 0, size.height());
+        painter.end();
+        QPixmapCache::insert(key, pixmap);
+    }
+    return pixmap;
+}
+
+
 void CensusVisualizerView::paintRow(QPainter *painter, int row,
                                     int y, const int RowHeight)
 {
@@ -196,17 +257,12 @@ void CensusVisualizerView::paintItemBackground(QPainter *painter,
 }
 
 
-// QLocale is needed because the data is stored as _strings_ with
-// locale-specific separators, e.g., 8.392.419 or 8,392,419.
 void CensusVisualizerView::paintMaleFemale(QPainter *painter,
         int row, const QRect &rect)
 {
     QRect rectangle(rect);
-    QLocale locale;
-    int males = locale.toInt(visualizer->model()->data(
-            visualizer->model()->index(row, Males)).toString());
-    int females = locale.toInt(visualizer->model()->data(
-            visualizer->model()->index(row, Females)).toString());
+    int males = visualizer->population(row, Males);
+    int females = visualizer->population(row, Females);
     qreal total = males + females;
     int offset = qRound(
             ((1 - (total / visualizer->maximumPopulation())) / 2) *
@@ -250,7 +306,6 @@ void CensusVisualizerView::paintTotal(QPainter *painter, int row,
                         visualizer->selectedColumn() == Total);
  // allow right margin
     painter->drawText(rect.adjusted(0, 0, -5, 0),
-            visualizer->model()->data(
-                visualizer->model()->index(row, Total)).toString(),
+            QLocale().toString(visualizer->population(row, Total)),
             QTextOption(Qt::AlignVCenter|Qt::AlignRight));
 }
@@ -20,9 +20,18 @@
 class QModelIndex;
 class QPainter;
 class QPaintEvent;
+class QPixmap;
 class CensusVisualizer;
 
 
+// Each row is rendered once into a pixmap strip that's kept in the
+// QPixmapCache, keyed by everything that affects how it looks: its
+// data, the column widths, the font, the palette, the scale, and which
+// of its columns (if any) is selected. Repainting just blits the
+// strips, and since changing the selection only repaints the rows
+// whose selection changed, only those are rendered again.
+
+
 class CensusVisualizerView : public QWidget
 {
     Q_OBJECT
@@ -32,6 +41,7 @@ public:
 
     QSize minimumSizeHint() const;
     QSize sizeHint() const;
+    void updateRow(int row);
 
 signals:
     void clicked(const QModelIndex&);
@@ -43,6 +53,9 @@ protected:
     void paintEvent(QPaintEvent *event);
 
 private:
+    int rowHeight() const;
+    QString cacheKeyForRow(int row, const QSize &size) const;
+    QPixmap rowStrip(int row, const QSize &size);
     void paintRow(QPainter *painter, int row, int y,
                   const int RowHeight);
     void paintItemBackground(QPainter *painter, const QRect &rect,
@@ -62,9 +62,14 @@ void populateModel(QStandardItemModel *model)
             int number = column == Columns
                     ? irish_census[row][1] + irish_census[row][2]
                     : irish_census[row][column];
-            QString text = column == 0 ? QString::number(number)
-                                       : QString("%L1").arg(number);
-            item = new QStandardItem(text);
+            // The populations are stored as ints (which the views
+            // show with the locale's separators), so that edits keep
+            // them as numbers
+            item = new QStandardItem;
+            if (column == 0)
+                item->setText(QString::number(number));
+            else
+                item->setData(number, Qt::EditRole);
             item->setTextAlignment(Qt::AlignVCenter|Qt::AlignRight);
             items << item;
         }
@@ -5,13 +5,15 @@ HYBRID_EGS	= browserwindow weathertrayicon rsspanel nyrbviewer \
 		  matrixquiz
 AUDIO_VIDEO_EGS = moviejingle
 MODEL_VIEW_EGS	= zipcodes1 zipcodes2 timelog1 timelog2 \
-		  folderview censusvisualizer tiledlistview
+		  folderview censusvisualizer tiledlistview timelogbench
 THREADING_EGS	= image2image numbergrid crossfader findduplicates
 RICH_TEXT_EGS	= outputsampler textedit xmledit
-GRAPHICS_EGS	= petridish1 pagedesigner1
+GRAPHICS_EGS	= petridish1 pagedesigner1 petridishbench
+ALGORITHM_EGS	= assignmentbench
 
 SUBDIRS		= $$AQP $$HYBRID_EGS $$AUDIO_VIDEO_EGS $$MODEL_VIEW_EGS \
-		  $$THREADING_EGS $$RICH_TEXT_EGS $$GRAPHICS_EGS
+		  $$THREADING_EGS $$RICH_TEXT_EGS $$GRAPHICS_EGS \
+		  $$ALGORITHM_EGS
 
 PHONON_EGS	= playmusic playvideo
 
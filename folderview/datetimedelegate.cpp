@@ -13,41 +13,197 @@
 
 #include "aqp.hpp"
 #include "datetimedelegate.hpp"
-#include <QDateTime>
+#include <QAbstractItemView>
+#include <QFileInfo>
 #include <QFileSystemModel>
 #include <QModelIndex>
 #include <QPainter>
+#include <QPixmapCache>
 #include <QPoint>
+#include <QtConcurrentRun>
+#include <QtCore/qmath.h>
+
+
+namespace {
+const int MinuteBucket = 5;
+const int MaxFetchBatchSize = 250;
+
+
+QList<QDateTime> lastModifiedTimes(const QStringList &paths)
+{
+    QList<QDateTime> times;
+    foreach (const QString &path, paths)
+        times << QFileInfo(path).lastModified();
+    return times;
+}
+
+} // anonymous namespace
+
+
+DateTimeDelegate::DateTimeDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+    connect(&fetcher, SIGNAL(finished()), this, SLOT(fetched()));
+}
 
 
 void DateTimeDelegate::paint(QPainter *painter,
         const QStyleOptionViewItem &option,
         const QModelIndex &index) const
 {
-    const QFileSystemModel *model =
-            qobject_cast<const QFileSystemModel*>(index.model());
-    Q_ASSERT(model);
-    const QDateTime &lastModified = model->lastModified(index);
+    QDateTime lastModified;
+    const bool known = lastModifiedFor(index, option.widget,
+                                       &lastModified);
     painter->save();
     painter->setRenderHints(QPainter::Antialiasing|
                             QPainter::TextAntialiasing);
 
     if (option.state & QStyle::State_Selected)
         painter->fillRect(option.rect, option.palette.highlight());
-    const qreal diameter = qMin(option.rect.width(),
-                                option.rect.height());
-    const QRectF rect = clockRect(option.rect, diameter);
-    drawClockFace(painter, rect, lastModified);
-    drawClockHand(painter, rect.center(), diameter / 3.5,
-                  ((lastModified.time().hour() +
-                   (lastModified.time().minute() / 60.0))) * 30);
-    drawClockHand(painter, rect.center(), diameter / 2.5,
-                  lastModified.time().minute() * 6);
-    drawDate(painter, option, diameter, lastModified);
+    if (known) {
+        const qreal diameter = qMin(option.rect.width(),
+                                    option.rect.height());
+        const qreal ratio = option.widget
+                ? option.widget->devicePixelRatio() : 1; //added for Qt5
+        painter->drawPixmap(option.rect.topLeft(),
+                            clockGlyph(diameter, ratio, lastModified));
+        drawDate(painter, option, diameter, lastModified);
+    }
     painter->restore();
 }
 
 
+// Returns false (and queues the index's file to be stat()ed) if its
+// last modified time isn't known yet
+bool DateTimeDelegate::lastModifiedFor(const QModelIndex &index,
+        const QWidget *widget, QDateTime *lastModified) const
+{
+    const QFileSystemModel *fileSystemModel =
+            qobject_cast<const QFileSystemModel*>(index.model());
+    Q_ASSERT(fileSystemModel);
+    if (fileSystemModel != model) {
+        if (model)
+            disconnect(model, 0, this, 0);
+        lastModifiedForPath.clear();
+        requestedPaths.clear();
+        pendingPaths.clear();
+        model = fileSystemModel;
+        connect(model, SIGNAL(dataChanged(const QModelIndex&,
+                                          const QModelIndex&)),
+                this, SLOT(invalidate(const QModelIndex&,
+                                      const QModelIndex&)));
+        connect(model, SIGNAL(modelReset()), this, SLOT(invalidateAll()));
+    }
+    const QString path = model->filePath(index);
+    QHash<QString, QDateTime>::const_iterator i =
+            lastModifiedForPath.constFind(path);
+    if (i != lastModifiedForPath.constEnd()) {
+        *lastModified = i.value();
+        return true;
+    }
+
+    if (const QAbstractItemView *view =
+            qobject_cast<const QAbstractItemView*>(widget)) {
+        QPointer<QWidget> viewport(view->viewport());
+        if (!viewports.contains(viewport))
+            viewports << viewport;
+    }
+    if (!requestedPaths.contains(path)) {
+        requestedPaths << path;
+        pendingPaths << path;
+        fetchPending();
+    }
+    return false;
+}
+
+
+void DateTimeDelegate::fetchPending() const
+{
+    if (fetcher.isRunning() || pendingPaths.isEmpty())
+        return;
+    fetchingPaths = pendingPaths.mid(0, MaxFetchBatchSize);
+    pendingPaths = pendingPaths.mid(MaxFetchBatchSize);
+    fetcher.setFuture(QtConcurrent::run(lastModifiedTimes,
+                                        fetchingPaths));
+}
+
+
+void DateTimeDelegate::fetched()
+{
+    const QList<QDateTime> times = fetcher.result();
+    for (int i = 0; i < fetchingPaths.count(); ++i) {
+        const QString &path = fetchingPaths.at(i);
+        if (requestedPaths.remove(path))
+            lastModifiedForPath.insert(path, times.at(i));
+    }
+    fetchingPaths.clear();
+    foreach (const QPointer<QWidget> &viewport, viewports) {
+        if (viewport)
+            viewport->update();
+    }
+    fetchPending();
+}
+
+
+// Files whose times were invalidated while being fetched are no longer
+// in requestedPaths, so their (possibly stale) results are ignored
+void DateTimeDelegate::invalidate(const QModelIndex &topLeft,
+                                  const QModelIndex &bottomRight)
+{
+    if (!model)
+        return;
+    const QModelIndex parent = topLeft.parent();
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        const QString path = model->filePath(model->index(row, 0,
+                                                          parent));
+        lastModifiedForPath.remove(path);
+        requestedPaths.remove(path);
+        pendingPaths.removeAll(path);
+    }
+}
+
+
+void DateTimeDelegate::invalidateAll()
+{
+    lastModifiedForPath.clear();
+    requestedPaths.clear();
+    pendingPaths.clear();
+}
+
+
+QPixmap DateTimeDelegate::clockGlyph(const qreal &diameter,
+        qreal devicePixelRatio, const QDateTime &lastModified) const
+{
+    const int hour = lastModified.time().hour();
+    const int minute = (lastModified.time().minute() / MinuteBucket) *
+                       MinuteBucket;
+    const bool today = lastModified.date() == QDate::currentDate();
+    const QString key = QString("CLOCKGLYPH:%1:%2:%3:%4:%5")
+            .arg(diameter).arg(devicePixelRatio).arg(hour).arg(minute)
+            .arg(today ? 1 : 0);
+    QPixmap pixmap;
+    if (!QPixmapCache::find(key, &pixmap)) {
+        const int size = qCeil(diameter);
+        pixmap = QPixmap(QSize(size, size) * devicePixelRatio);
+        pixmap.setDevicePixelRatio(devicePixelRatio); //added for Qt5
+        pixmap.fill(Qt::transparent);
+        QPainter painter(&pixmap);
+        painter.setRenderHints(QPainter::Antialiasing);
+        const QRectF rect = clockRect(QRectF(0, 0, size, size),
+                                      diameter);
+        const QDateTime time(lastModified.date(), QTime(hour, minute));
+        drawClockFace(&painter, rect, time);
+        drawClockHand(&painter, rect.center(), diameter / 3.5,
+                      (hour + (minute / 60.0)) * 30);
+        drawClockHand(&painter, rect.center(), diameter / 2.5,
+                      minute * 6);
+        painter.end();
+        QPixmapCache::insert(key, pixmap);
+    }
+    return pixmap;
+}
+
+
 QRectF DateTimeDelegate::clockRect(const QRectF &rect,
                                    const qreal &diameter) const
 {
@@ -13,26 +13,56 @@
     the GNU General Public License for more details.
 */
 
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QSet>
+#include <QStringList>
 #include <QStyledItemDelegate>
 
 
+class QFileSystemModel;
 class QModelIndex;
 class QPainter;
 class QStyleOptionViewItem;
 
 
+// Getting a file's last modified time can block for a long time, e.g.,
+// on a network home directory, so paint() never does it. Instead it
+// uses the times it already knows and queues the paths it doesn't
+// know; these are stat()ed in batches in a worker thread and the views
+// are repainted when each batch arrives. Cached times are dropped
+// whenever the model reports that their files have changed.
+//
+// The clock faces are drawn once and kept in the QPixmapCache, keyed by
+// size, hour, minute (to the nearest MinuteBucket minutes) and whether
+// the time is today, so painting a cell is normally just a blit and
+// some text.
+
 class DateTimeDelegate : public QStyledItemDelegate
 {
     Q_OBJECT
 
 public:
-    explicit DateTimeDelegate(QObject *parent=0)
-        : QStyledItemDelegate(parent) {}
+    explicit DateTimeDelegate(QObject *parent=0);
 
     void paint(QPainter *painter, const QStyleOptionViewItem &option,
                const QModelIndex &index) const;
 
+private slots:
+    void fetched();
+    void invalidate(const QModelIndex &topLeft,
+                    const QModelIndex &bottomRight);
+    void invalidateAll();
+
 private:
+    bool lastModifiedFor(const QModelIndex &index, const QWidget *widget,
+                         QDateTime *lastModified) const;
+    void fetchPending() const;
+    QPixmap clockGlyph(const qreal &diameter, qreal devicePixelRatio,
+                       const QDateTime &lastModified) const;
     QRectF clockRect(const QRectF &rect, const qreal &diameter) const;
     void drawClockFace(QPainter *painter, const QRectF &rect,
                        const QDateTime &lastModified) const;
@@ -41,6 +71,14 @@ private:
     void drawDate(QPainter *painter,
             const QStyleOptionViewItem &option, const qreal &size,
             const QDateTime &lastModified) const;
+
+    mutable QPointer<const QFileSystemModel> model;
+    mutable QList<QPointer<QWidget> > viewports;
+    mutable QHash<QString, QDateTime> lastModifiedForPath;
+    mutable QSet<QString> requestedPaths; // Queued or being fetched
+    mutable QStringList pendingPaths;
+    mutable QStringList fetchingPaths;
+    mutable QFutureWatcher<QList<QDateTime> > fetcher;
 };
 
 #endif // DATETIMEDELEGATE_HPP
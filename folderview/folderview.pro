@@ -10,5 +10,5 @@ INCLUDEPATH += ../aqp
 HEADERS	    += datetimedelegate.hpp
 SOURCES     += datetimedelegate.cpp
 SOURCES     += main.cpp
-QT += widgets #added for Qt5
+QT += widgets concurrent #added for Qt5
 #DEFINES	    += DEBUG
@@ -14,22 +14,108 @@
 #include "aqp.hpp"
 #include "cell.hpp"
 #include <QStyleOptionGraphicsItem>
+#include <QFontMetricsF>
 #include <QPainter>
 
 
+namespace {
+const int Vertices = 360;
+const qreal MaxJitter = 1.0 + (1.0 / 6);
+// Divisors of Vertices, so every level of detail closes up evenly
+const int Strides[] = {1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 15, 18, 20, 24,
+                       30};
+const int StrideCount = sizeof(Strides) / sizeof(Strides[0]);
+
 inline qreal randomReal() { return ((qrand() % 100) / 100.0); }
 
 
+const QVector<QPointF> &unitCircle()
+{
+    static QVector<QPointF> points;
+    if (points.isEmpty()) {
+        points.reserve(Vertices);
+        for (int angle = 0; angle < Vertices; ++angle) {
+            const qreal radians = AQP::radiansFromDegrees(angle);
+#ifdef MSVC_COMPILER
+            points << QPointF(cos(radians), sin(radians));
+#else
+            points << QPointF(std::cos(radians), std::sin(radians));
+#endif
+        }
+    }
+    return points;
+}
+
+
+// Roughly one vertex per on-screen pixel of circumference / 3, which is
+// indistinguishable from the full outline once antialiased.
+int strideForDiameter(qreal pixels)
+{
+    const int wanted = Vertices / qBound(1, qRound(pixels), Vertices);
+    int stride = Strides[0];
+    for (int i = 1; i < StrideCount && Strides[i] <= wanted; ++i)
+        stride = Strides[i];
+    return stride;
+}
+
+} // anonymous namespace
+
+
 bool Cell::s_showIds = true;
+bool Cell::s_levelOfDetail = true;
 
 
 Cell::Cell(int id, QGraphicsItem *parent)
-    : QGraphicsItem(parent), m_id(id)
+    : QGraphicsItem(parent), m_jitterOffset(0), m_outlineStride(0),
+      m_id(id), m_size(0.0)
 {
     m_brush = QBrush(QColor(qrand() % 200, qrand() % 200,
                      qrand() % 200, qMax(127, qrand() % 256)));
-    m_size = 5.5 + (qrand() % 10);
-    shrinkOrGrow();
+    m_jitter.reserve(Vertices);
+    for (int i = 0; i < Vertices; ++i)
+        m_jitter << 1.0 + ((randomReal() - 0.5) / 3);
+    const QFontMetricsF metrics((QFont()));
+    const QString text = QString::number(m_id);
+    const qreal width = metrics.width(text);
+    m_idRect = QRectF(-width / 2, -metrics.height() / 2, width,
+                      metrics.height());
+    setCacheMode(DeviceCoordinateCache);
+}
+
+
+// The id is included even when it isn't shown so that toggling it
+// doesn't change the geometry; it overhangs the smallest cells and
+// would otherwise be clipped from their cached pixmaps
+QRectF Cell::boundingRect() const
+{
+    const qreal radius = m_size * MaxJitter;
+    return QRectF(-radius, -radius, 2 * radius, 2 * radius)
+            .united(m_idRect);
+}
+
+
+QPainterPath Cell::shape() const
+{
+    if (m_path.isEmpty()) {
+        m_path.addPolygon(outline(1));
+        m_path.closeSubpath();
+    }
+    return m_path;
+}
+
+
+const QPolygonF &Cell::outline(int stride) const
+{
+    if (stride != m_outlineStride) {
+        const QVector<QPointF> &points = unitCircle();
+        m_outline.clear();
+        m_outline.reserve(Vertices / stride);
+        for (int i = 0; i < Vertices; i += stride)
+            m_outline << points.at(i) * (m_size *
+                    m_jitter.at((i + m_jitterOffset) % Vertices));
+        m_outlineStride = stride;
+    }
+    return m_outline;
 }
 
 
@@ -38,60 +124,33 @@ void Cell::paint(QPainter *painter,
 {
     painter->setPen(Qt::NoPen);
     painter->setBrush(m_brush);
-    painter->drawPath(m_path);
+    int stride = 1;
+    if (s_levelOfDetail)
+        stride = strideForDiameter(2 * m_size *
+                option->levelOfDetailFromTransform(
+                        painter->worldTransform()));
+    painter->drawPolygon(outline(stride));
     if (s_showIds) {
-        QPointF center = m_path.boundingRect().center();
-        QString id = QString::number(m_id);
-        center.setX(center.x() - (option->fontMetrics.width(id) / 2));
-        center.setY(center.y() + (option->fontMetrics.height() / 4));
         painter->setPen(QPen());
-        painter->drawText(center, id);
+        painter->setFont(QFont());
+        painter->drawText(m_idRect, Qt::AlignCenter,
+                          QString::number(m_id));
     }
 }
 
 
-Cell::CellState Cell::shrinkOrGrow()
+// The jitter buffer is made once per cell; a new size just rotates it
+// and rescales it, so the outline still wobbles from tick to tick
+// without any trigonometry or random numbers per vertex.
+void Cell::setSize(qreal size)
 {
-    int dishSize = qRound(parentItem()->boundingRect().width());
-    int neighbours = 0;
-    QListIterator<QGraphicsItem*> i(parentItem()->childItems());
-    while (i.hasNext()) {
-        QGraphicsItem *item = i.next();
-        if (item != this && collidesWithItem(item))
-            ++neighbours;
-    }
-    if (!neighbours || m_size > dishSize / 3)
-        m_size *= randomReal(); // shrink - lonely or too big
-    else if (neighbours < 4) // grow - happy
-        m_size *= ((5 - neighbours) * randomReal());
-    else // shrink - too crowded
-        m_size *= ((1.0 / neighbours) + randomReal());
-
-    QPainterPath path;
-#ifdef MSVC_COMPILER
-    qreal x = m_size * cos(AQP::radiansFromDegrees(1));
-    qreal y = m_size * sin(AQP::radiansFromDegrees(1));
-#else
-    qreal x = m_size * std::cos(AQP::radiansFromDegrees(1));
-    qreal y = m_size * std::sin(AQP::radiansFromDegrees(1));
-#endif
-    path.moveTo(x, y);
-    for (int angle = 1; angle < 360; ++angle) {
-        qreal factor = m_size + ((m_size / 3) * (randomReal() - 0.5));
-#ifdef MSVC_COMPILER
-        x = factor * cos(AQP::radiansFromDegrees(angle));
-        y = factor * sin(AQP::radiansFromDegrees(angle));
-#else
-        x = factor * std::cos(AQP::radiansFromDegrees(angle));
-        y = factor * std::sin(AQP::radiansFromDegrees(angle));
-#endif
-        path.lineTo(x, y);
-    }
-    path.closeSubpath();
-    m_path = path;
-
+    if (qFuzzyCompare(size, m_size))
+        return;
     prepareGeometryChange();
-    if (m_size < 5.0 && (qrand() % 20 == 0))
-        return Die; // small ones randomly die
-    return Live;
+    m_size = size;
+    m_jitterOffset = (m_jitterOffset + 1 + (qrand() % (Vertices - 1))) %
+                     Vertices;
+    m_path = QPainterPath();
+    m_outlineStride = 0;
+    update();
 }
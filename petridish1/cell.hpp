@@ -15,6 +15,8 @@
 
 #include <QBrush>
 #include <QGraphicsItem>
+#include <QPolygonF>
+#include <QVector>
 
 
 class QPainter;
@@ -25,28 +27,38 @@ class Cell : public QGraphicsItem
 {
 public:
     enum {Type = UserType + 1};
-    enum CellState {Live, Die};
 
     explicit Cell(int id, QGraphicsItem *parent=0);
 
-    QRectF boundingRect() const { return m_path.boundingRect(); }
-    QPainterPath shape() const { return m_path; }
+    QRectF boundingRect() const;
+    QPainterPath shape() const;
     void paint(QPainter *painter,
             const QStyleOptionGraphicsItem *option, QWidget *widget);
     int type() const { return Type; }
 
-    CellState shrinkOrGrow();
     int id() const { return m_id; }
+    qreal size() const { return m_size; }
+    void setSize(qreal size);
 
     static bool showIds() { return s_showIds; }
     static void setShowIds(bool show) { s_showIds = show; }
+    static bool levelOfDetail() { return s_levelOfDetail; }
+    static void setLevelOfDetail(bool on) { s_levelOfDetail = on; }
 
 private:
+    const QPolygonF &outline(int stride) const;
+
     static bool s_showIds;
+    static bool s_levelOfDetail;
 
     QBrush m_brush;
-    QPainterPath m_path;
+    QVector<qreal> m_jitter;
+    int m_jitterOffset;
+    mutable QPainterPath m_path;
+    mutable QPolygonF m_outline;
+    mutable int m_outlineStride;
     const int m_id;
+    QRectF m_idRect;
     qreal m_size;
 };
 
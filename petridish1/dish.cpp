@@ -0,0 +1,201 @@
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include "aqp.hpp"
+#include "dish.hpp"
+#include <QThread>
+#include <QtConcurrentMap>
+
+
+namespace {
+const int ParallelThreshold = 256;
+
+
+// A splitmix64 generator: tiny, fast, and good enough for a petri dish.
+// Unlike qrand() it has no shared state, so each cell can have its own.
+class Random
+{
+public:
+    explicit Random(quint64 seed) : m_state(seed) {}
+
+    quint64 next()
+    {
+        quint64 z = (m_state += Q_UINT64_C(0x9E3779B97F4A7C15));
+        z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+        z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+        return z ^ (z >> 31);
+    }
+    int integer(int limit) { return static_cast<int>(next() % limit); }
+    qreal real() { return integer(100) / 100.0; }
+
+private:
+    quint64 m_state;
+};
+
+
+inline quint64 streamSeed(quint64 seed, int iteration, int id)
+{
+    return Random(seed ^ ((static_cast<quint64>(iteration) << 32) |
+                          static_cast<quint32>(id))).next();
+}
+
+} // anonymous namespace
+
+
+Dish::Dish(qreal diameter)
+    : m_seed(0), m_diameter(diameter), m_iterations(0)
+{
+}
+
+
+void Dish::clear()
+{
+    m_iterations = 0;
+    m_ids.clear();
+    m_xs.clear();
+    m_ys.clear();
+    m_sizes.clear();
+    m_nextSizes.clear();
+    m_states.clear();
+    m_died.clear();
+}
+
+
+void Dish::populate(int count)
+{
+    clear();
+    m_ids.reserve(count);
+    m_xs.reserve(count);
+    m_ys.reserve(count);
+    m_sizes.reserve(count);
+    m_states.reserve(count);
+    Random random(streamSeed(m_seed, -1, count));
+    const int radius = qMax(1, qRound(m_diameter / 2));
+    for (int i = 0; i < count; ++i) {
+        qreal radians = AQP::radiansFromDegrees(random.integer(360));
+        qreal factor = random.integer(radius);
+        m_ids << i;
+#ifdef MSVC_COMPILER
+        m_xs << qRound(factor * cos(radians));
+        m_ys << qRound(factor * sin(radians));
+#else
+        m_xs << qRound(factor * std::cos(radians));
+        m_ys << qRound(factor * std::sin(radians));
+#endif
+        m_sizes << 5.5 + random.integer(10);
+        m_states << Live;
+    }
+}
+
+
+// Each cell's outline is a jittered circle of radius size +/- size/6,
+// so two cells are neighbours if their nominal circles overlap.
+int Dish::neighboursOf(int index) const
+{
+    const qreal x = m_xs.at(index);
+    const qreal y = m_ys.at(index);
+    const qreal size = m_sizes.at(index);
+    int neighbours = 0;
+    for (int i = 0; i < m_ids.count(); ++i) {
+        if (i == index)
+            continue;
+        const qreal dx = m_xs.at(i) - x;
+        const qreal dy = m_ys.at(i) - y;
+        const qreal reach = m_sizes.at(i) + size;
+        if ((dx * dx) + (dy * dy) < reach * reach)
+            ++neighbours;
+    }
+    return neighbours;
+}
+
+
+// Reads only the current buffers, so it is safe to call from any number
+// of threads at once.
+Dish::CellState Dish::nextState(int index, qreal *size) const
+{
+    Random random(streamSeed(m_seed, m_iterations, m_ids.at(index)));
+    const int neighbours = neighboursOf(index);
+    *size = m_sizes.at(index);
+    if (!neighbours || *size > qRound(m_diameter) / 3)
+        *size *= random.real(); // shrink - lonely or too big
+    else if (neighbours < 4) // grow - happy
+        *size *= ((5 - neighbours) * random.real());
+    else // shrink - too crowded
+        *size *= ((1.0 / neighbours) + random.real());
+
+    if (*size < 5.0 && (random.integer(20) == 0))
+        return Die; // small ones randomly die
+    return Live;
+}
+
+
+void Dish::stepChunk(Chunk &chunk)
+{
+    for (int i = chunk.begin; i < chunk.end; ++i)
+        chunk.states[i] = chunk.dish->nextState(i, &chunk.sizes[i]);
+}
+
+
+int Dish::step()
+{
+    m_died.clear();
+    const int count = m_ids.count();
+    m_nextSizes.resize(count);
+    m_states.resize(count);
+
+    QVector<Chunk> chunks;
+    const int chunkCount = count < ParallelThreshold ? 1
+            : QThread::idealThreadCount();
+    int offset = 0;
+    foreach (const int chunkSize, AQP::chunkSizes(qMax(1, count),
+                                                  qMax(1, chunkCount))) {
+        Chunk chunk = {this, offset, qMin(count, offset + chunkSize),
+                       m_nextSizes.data(), m_states.data()};
+        chunks << chunk;
+        offset += chunkSize;
+    }
+    if (chunks.count() == 1)
+        stepChunk(chunks[0]);
+    else
+        QtConcurrent::blockingMap(chunks, stepChunk);
+
+    m_sizes.swap(m_nextSizes);
+    removeDead();
+    ++m_iterations;
+    return m_ids.count();
+}
+
+
+void Dish::removeDead()
+{
+    int j = 0;
+    for (int i = 0; i < m_ids.count(); ++i) {
+        if (m_states.at(i) == Die) {
+            m_died << m_ids.at(i);
+            continue;
+        }
+        if (i != j) {
+            m_ids[j] = m_ids.at(i);
+            m_xs[j] = m_xs.at(i);
+            m_ys[j] = m_ys.at(i);
+            m_sizes[j] = m_sizes.at(i);
+            m_states[j] = m_states.at(i);
+        }
+        ++j;
+    }
+    m_ids.resize(j);
+    m_xs.resize(j);
+    m_ys.resize(j);
+    m_sizes.resize(j);
+    m_states.resize(j);
+}
@@ -0,0 +1,82 @@
+#ifndef DISH_HPP
+#define DISH_HPP
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include <QVector>
+
+
+// The simulation itself: no QGraphicsItems, no painting, just a
+// struct-of-arrays of cell positions (relative to the dish's center),
+// sizes and ids. It can be stepped without any GUI at all; the
+// MainWindow syncs its Cell items from it after each step.
+//
+// Each step is double-buffered: every cell's next size and state is
+// computed from the previous step's sizes (in parallel for big dishes),
+// and only then are the results committed. The random numbers a cell
+// gets depend only on the seed, the iteration and the cell's id, so
+// the same seed always gives the same run however many threads are
+// used.
+
+class Dish
+{
+public:
+    enum CellState {Live, Die};
+
+    explicit Dish(qreal diameter=350.0);
+
+    quint64 seed() const { return m_seed; }
+    void setSeed(quint64 seed) { m_seed = seed; }
+    qreal diameter() const { return m_diameter; }
+    void setDiameter(qreal diameter) { m_diameter = diameter; }
+
+    void clear();
+    void populate(int count);
+    int step();
+
+    int iterations() const { return m_iterations; }
+    int count() const { return m_ids.count(); }
+    int id(int index) const { return m_ids.at(index); }
+    qreal x(int index) const { return m_xs.at(index); }
+    qreal y(int index) const { return m_ys.at(index); }
+    qreal size(int index) const { return m_sizes.at(index); }
+    const QVector<int> &died() const { return m_died; }
+
+private:
+    struct Chunk
+    {
+        const Dish *dish;
+        int begin;
+        int end;
+        qreal *sizes;
+        CellState *states;
+    };
+
+    static void stepChunk(Chunk &chunk);
+    int neighboursOf(int index) const;
+    CellState nextState(int index, qreal *size) const;
+    void removeDead();
+
+    quint64 m_seed;
+    qreal m_diameter;
+    int m_iterations;
+    QVector<int> m_ids;
+    QVector<qreal> m_xs;
+    QVector<qreal> m_ys;
+    QVector<qreal> m_sizes;
+    QVector<qreal> m_nextSizes;
+    QVector<CellState> m_states;
+    QVector<int> m_died;
+};
+
+#endif // DISH_HPP
@@ -14,6 +14,7 @@
 */
 
 #include "cell.hpp"
+#include "dish.hpp"
 #include <QHash>
 #include <QList>
 #include <QMainWindow>
@@ -38,6 +39,7 @@ public:
 
 protected:
     void closeEvent(QCloseEvent *event);
+    bool eventFilter(QObject *target, QEvent *event);
 
 private slots:
     void start();
@@ -45,6 +47,7 @@ private slots:
     void stop();
     void doOneIteration();
     void showIds(bool show);
+    void syncCells();
 
 private:
     enum SimulationState {Stopped, Running, Paused};
@@ -71,7 +74,8 @@ private:
     QCheckBox *showIdsCheckBox;
     QHash<QString, QGraphicsProxyWidget*> proxyForName;
 
-    QList<Cell*> cells;
+    Dish dish;
+    QHash<int, Cell*> cellForId;
     SimulationState simulationState;
     int iterations;
 };
@@ -8,7 +8,9 @@ SOURCES	    += ../aqp/aqp.cpp
 INCLUDEPATH += ../aqp
 HEADERS	    += cell.hpp
 SOURCES	    += cell.cpp
+HEADERS	    += dish.hpp
+SOURCES	    += dish.cpp
 HEADERS	    += mainwindow.hpp
 SOURCES	    += mainwindow.cpp
 SOURCES	    += main.cpp
-QT += widgets #added for Qt5
+QT += widgets concurrent #added for Qt5
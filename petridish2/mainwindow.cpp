@@ -26,6 +26,7 @@
 #include <QLCDNumber>
 #include <QList>
 #include <QPushButton>
+#include <QScrollBar>
 #include <QSpinBox>
 #include <QTimer>
 
@@ -249,12 +250,27 @@ void MainWindow::createConnections()
     connect(pausedState, SIGNAL(entered()),
             this, SLOT(pause()));
     connect(&stateMachine, SIGNAL(finished()), this, SLOT(close()));
+    connect(view->horizontalScrollBar(), SIGNAL(valueChanged(int)),
+            this, SLOT(syncCells()));
+    connect(view->verticalScrollBar(), SIGNAL(valueChanged(int)),
+            this, SLOT(syncCells()));
+    view->viewport()->installEventFilter(this);
+}
+
+
+bool MainWindow::eventFilter(QObject *target, QEvent *event)
+{
+    if (target == view->viewport() && event->type() == QEvent::Resize)
+        syncCells();
+    return QMainWindow::eventFilter(target, event);
 }
 
 
 void MainWindow::showIds(bool show)
 {
     Cell::setShowIds(show);
+    foreach (Cell *cell, cellForId)
+        cell->update(); // refresh their cached pixmaps
     scene->invalidate();
 }
 
@@ -262,7 +278,8 @@ void MainWindow::showIds(bool show)
 void MainWindow::closeEvent(QCloseEvent *event)
 {
     setRunning(false);
-    qDeleteAll(cells);
+    qDeleteAll(cellForId);
+    cellForId.clear();
     event->accept();
 }
 
@@ -271,27 +288,15 @@ void MainWindow::start()
 {
     setWindowOpacity(1.0);
     iterationsLCD->display(iterations = 0);
-    qDeleteAll(cells);
-    cells.clear();
+    qDeleteAll(cellForId);
+    cellForId.clear();
     QRectF rect = dishItem->sceneBoundingRect();
-    int xOffset = qRound(rect.x() + (rect.width() / 2));
-    int yOffset = qRound(rect.y() + (rect.height() / 2));
-    for (int i = 0; i < initialCountSpinBox->value(); ++i) {
-        int angle = qrand() % 360;
-        qreal factor = qrand() % qRound(rect.width() / 2);
-#ifdef MSVC_COMPILER
-        int x = qRound(factor * cos(AQP::radiansFromDegrees(angle)));
-        int y = qRound(factor * sin(AQP::radiansFromDegrees(angle)));
-#else
-        int x = qRound(factor *
-                std::cos(AQP::radiansFromDegrees(angle)));
-        int y = qRound(factor *
-                std::sin(AQP::radiansFromDegrees(angle)));
-#endif
-        Cell *cell = new Cell(i, dishItem);
-        cell->setPos(x + xOffset, y + yOffset);
-        cells << cell;
-    }
+    dish.setSeed(qrand());
+    dish.setDiameter(rect.width());
+    dish.populate(initialCountSpinBox->value());
+    for (int i = 0; i < dish.count(); ++i)
+        cellForId[dish.id(i)] = new Cell(dish.id(i), dishItem);
+    syncCells();
     scene->invalidate();
     update();
     QTimer::singleShot(IterationDelay, this, SLOT(doOneIteration()));
@@ -302,19 +307,8 @@ void MainWindow::doOneIteration()
 {
     if (!running())
         return;
-    int count = 0;
-    QMutableListIterator<Cell*> i(cells);
-    while (i.hasNext()) {
-        Cell *cell = i.next();
-        if (!cell)
-            continue;
-        if (cell->shrinkOrGrow() == Cell::Die) {
-            i.remove();
-            delete cell;
-        }
-        else
-            ++count;
-    }
+    int count = dish.step();
+    syncCells();
     scene->invalidate();
     iterationsLCD->display(++iterations);
     currentCountLCD->display(count);
@@ -327,6 +321,36 @@ void MainWindow::doOneIteration()
 }
 
 
+// Only the cells that intersect the part of the dish that the view
+// actually shows get their outlines rebuilt; the rest are hidden and
+// caught up on a later sync when they come into view, which is also
+// done whenever the view is scrolled or resized, so that cells show up
+// even while the simulation is paused or stopped.
+void MainWindow::syncCells()
+{
+    foreach (const int id, dish.died())
+        delete cellForId.take(id);
+    const QRectF rect = dishItem->sceneBoundingRect();
+    const QPointF center = rect.center();
+    const QRectF visibleRect = rect & view->mapToScene(
+            view->viewport()->rect()).boundingRect();
+    for (int i = 0; i < dish.count(); ++i) {
+        Cell *cell = cellForId.value(dish.id(i));
+        if (!cell)
+            continue;
+        const QPointF pos = center + QPointF(dish.x(i), dish.y(i));
+        const qreal reach = dish.size(i) * 1.2;
+        const bool visible = visibleRect.intersects(QRectF(
+                pos.x() - reach, pos.y() - reach, 2 * reach, 2 * reach));
+        cell->setVisible(visible);
+        if (visible) {
+            cell->setPos(pos);
+            cell->setSize(dish.size(i));
+        }
+    }
+}
+
+
 void MainWindow::pause()
 {
     setWindowOpacity(0.95);
@@ -14,6 +14,7 @@
 */
 
 #include "cell.hpp"
+#include "dish.hpp"
 #include <QHash>
 #include <QList>
 #include <QMainWindow>
@@ -42,12 +43,14 @@ public:
 
 protected:
     void closeEvent(QCloseEvent *event);
+    bool eventFilter(QObject *target, QEvent *event);
 
 private slots:
     void start();
     void pause();
     void doOneIteration();
     void showIds(bool show);
+    void syncCells();
 
 private:
     void createWidgets();
@@ -89,7 +92,8 @@ private:
 #endif
 */
 
-    QList<Cell*> cells;
+    Dish dish;
+    QHash<int, Cell*> cellForId;
     int iterations;
     bool m_running;
 };
@@ -13,9 +13,11 @@ SOURCES	    += ../aqp/aqp.cpp
 INCLUDEPATH += ../aqp
 HEADERS	    += ../petridish1/cell.hpp
 SOURCES	    += ../petridish1/cell.cpp
+HEADERS	    += ../petridish1/dish.hpp
+SOURCES	    += ../petridish1/dish.cpp
 INCLUDEPATH += ../petridish1
 HEADERS	    += mainwindow.hpp
 SOURCES	    += mainwindow.cpp
 SOURCES	    += ../petridish1/main.cpp
-QT += widgets #added for Qt5
+QT += widgets concurrent #added for Qt5
 win32 { INCLUDEPATH += . }
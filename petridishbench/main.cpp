@@ -0,0 +1,242 @@
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include "dish.hpp"
+#include "option_parser.hpp"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QVector>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+
+namespace {
+const qint32 MagicNumber = 0x50657472;
+const qint16 FormatNumber = 100;
+
+
+// FNV-1a over every live cell's id and the exact bits of its size, so
+// a replay only matches if the run is bit-for-bit identical.
+quint64 checksum(const Dish &dish)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < dish.count(); ++i) {
+        quint64 values[2];
+        values[0] = static_cast<quint64>(dish.id(i));
+        const double size = dish.size(i);
+        std::memcpy(&values[1], &size, sizeof(size));
+        for (int j = 0; j < 2; ++j) {
+            for (int shift = 0; shift < 64; shift += 8) {
+                hash ^= (values[j] >> shift) & 0xFF;
+                hash *= Q_UINT64_C(1099511628211);
+            }
+        }
+    }
+    return hash;
+}
+
+
+qint64 peakMemoryKB()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss / 1024; // bytes on Mac OS X
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+
+double percentileMSec(const QVector<qint64> &sortedNSecs, int percent)
+{
+    if (sortedNSecs.isEmpty())
+        return 0.0;
+    const int index = qMin(sortedNSecs.count() - 1,
+                           (sortedNSecs.count() * percent) / 100);
+    return sortedNSecs.at(index) / 1000000.0;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    AQP::OptionParser parser(app.arguments(),
+            "usage: {program} [options]\n"
+            "\nRuns the petridish simulation without a window and "
+            "reports how fast it goes.\nA run can be recorded and "
+            "later replayed to check that it is reproduced exactly.\n",
+            "\nCopyright (c) 2009-10 Qtrac Ltd. All rights reserved.");
+    AQP::IntegerOptionPtr seedOpt = parser.addIntegerOption("s",
+                                                            "seed");
+    seedOpt->setHelp("random number seed");
+    seedOpt->setDefaultValue(1);
+    AQP::IntegerOptionPtr countOpt = parser.addIntegerOption("c",
+                                                             "count");
+    countOpt->setHelp("initial number of cells");
+    countOpt->setDefaultValue(60);
+    countOpt->setMinimum(1);
+    AQP::IntegerOptionPtr iterationsOpt = parser.addIntegerOption("i",
+            "iterations");
+    iterationsOpt->setHelp("maximum number of iterations");
+    iterationsOpt->setDefaultValue(1000);
+    iterationsOpt->setMinimum(1);
+    AQP::IntegerOptionPtr diameterOpt = parser.addIntegerOption("d",
+            "diameter");
+    diameterOpt->setHelp("dish diameter");
+    diameterOpt->setDefaultValue(350);
+    diameterOpt->setMinimum(2);
+    AQP::IntegerOptionPtr threadsOpt = parser.addIntegerOption("t",
+            "threads");
+    threadsOpt->setHelp("maximum worker threads (0 means one per core)");
+    threadsOpt->setDefaultValue(0);
+    threadsOpt->setMinimum(0);
+    AQP::StringOptionPtr recordOpt = parser.addStringOption("r",
+                                                            "record");
+    recordOpt->setHelp("record the run to this file");
+    AQP::StringOptionPtr replayOpt = parser.addStringOption("p",
+                                                            "replay");
+    replayOpt->setHelp("replay the run recorded in this file (its "
+                       "seed, count, iterations and diameter are used)");
+    if (!parser.parse())
+        return 2;
+
+    quint64 seed = static_cast<quint64>(seedOpt->value());
+    qint32 count = countOpt->value();
+    qint32 iterations = iterationsOpt->value();
+    qint32 diameter = diameterOpt->value();
+    if (threadsOpt->value() > 0)
+        QThreadPool::globalInstance()->setMaxThreadCount(
+                threadsOpt->value());
+
+    QFile replayFile;
+    QDataStream in;
+    if (replayOpt->hasValue()) {
+        replayFile.setFileName(replayOpt->value());
+        if (!replayFile.open(QIODevice::ReadOnly)) {
+            err << replayFile.fileName() << ": "
+                << replayFile.errorString() << "\n";
+            return 1;
+        }
+        in.setDevice(&replayFile);
+        qint32 magicNumber;
+        in >> magicNumber;
+        if (magicNumber != MagicNumber) {
+            err << replayFile.fileName() << ": unrecognized file type\n";
+            return 1;
+        }
+        qint16 formatVersionNumber;
+        in >> formatVersionNumber;
+        if (formatVersionNumber > FormatNumber) {
+            err << replayFile.fileName()
+                << ": file format version is too new\n";
+            return 1;
+        }
+        in.setVersion(QDataStream::Qt_4_5);
+        in >> seed >> count >> iterations >> diameter;
+    }
+
+    QFile recordFile;
+    QDataStream recordOut;
+    if (recordOpt->hasValue()) {
+        recordFile.setFileName(recordOpt->value());
+        if (!recordFile.open(QIODevice::WriteOnly)) {
+            err << recordFile.fileName() << ": "
+                << recordFile.errorString() << "\n";
+            return 1;
+        }
+        recordOut.setDevice(&recordFile);
+        recordOut << MagicNumber << FormatNumber;
+        recordOut.setVersion(QDataStream::Qt_4_5);
+        recordOut << seed << count << iterations << diameter;
+    }
+
+    Dish dish(diameter);
+    dish.setSeed(seed);
+    dish.populate(count);
+
+    QVector<qint64> tickNSecs;
+    tickNSecs.reserve(iterations);
+    int mismatch = -1;
+    QElapsedTimer tickTimer;
+    QElapsedTimer totalTimer;
+    totalTimer.start();
+    while (dish.iterations() < iterations && dish.count() > 1) {
+        tickTimer.start();
+        dish.step();
+        tickNSecs << tickTimer.nsecsElapsed();
+        if (!recordFile.isOpen() && !replayFile.isOpen())
+            continue;
+        const qint32 cells = dish.count();
+        const quint64 hash = checksum(dish);
+        if (recordFile.isOpen())
+            recordOut << cells << hash;
+        if (replayFile.isOpen() && mismatch == -1) {
+            qint32 recordedCells;
+            quint64 recordedHash;
+            in >> recordedCells >> recordedHash;
+            if (in.status() != QDataStream::Ok ||
+                recordedCells != cells || recordedHash != hash)
+                mismatch = dish.iterations();
+        }
+    }
+    const qint64 totalNSecs = totalTimer.nsecsElapsed();
+    if (replayFile.isOpen() && mismatch == -1 && !in.atEnd())
+        mismatch = dish.iterations() + 1;
+
+    QVector<qint64> sorted = tickNSecs;
+    qSort(sorted);
+    out << "seed " << seed << ", " << count << " cells, diameter "
+        << diameter << ", " << QThreadPool::globalInstance()
+                                   ->maxThreadCount() << " threads\n";
+    out << "iterations: " << dish.iterations() << " (" << dish.count()
+        << " cells left)\n";
+    out << "iterations/s: " << (totalNSecs > 0
+            ? QString::number(dish.iterations() * 1e9 / totalNSecs, 'f',
+                              1) : QString("n/a")) << "\n";
+    out << "ms per tick: p50 " << percentileMSec(sorted, 50)
+        << ", p90 " << percentileMSec(sorted, 90)
+        << ", p99 " << percentileMSec(sorted, 99)
+        << ", max " << percentileMSec(sorted, 100) << "\n";
+    const qint64 peakKB = peakMemoryKB();
+    out << "peak memory: " << (peakKB < 0 ? QString("n/a")
+            : QString("%1 KB").arg(peakKB)) << "\n";
+    if (recordFile.isOpen())
+        out << "recorded: " << recordFile.fileName() << "\n";
+    if (replayFile.isOpen()) {
+        if (mismatch == -1)
+            out << "replay: identical to " << replayFile.fileName()
+                << "\n";
+        else {
+            out << "replay: differs from " << replayFile.fileName()
+                << " at iteration " << mismatch << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+CONFIG	    += console release
+CONFIG	    -= app_bundle
+HEADERS	    += ../aqp/aqp.hpp
+SOURCES	    += ../aqp/aqp.cpp
+INCLUDEPATH += ../aqp
+HEADERS	    += ../option_parser/option_parser.hpp
+SOURCES	    += ../option_parser/option_parser.cpp
+INCLUDEPATH += ../option_parser
+HEADERS	    += ../petridish1/dish.hpp
+SOURCES	    += ../petridish1/dish.cpp
+INCLUDEPATH += ../petridish1
+SOURCES	    += main.cpp
+QT += widgets concurrent
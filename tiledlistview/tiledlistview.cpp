@@ -13,111 +13,263 @@
 
 #include "tiledlistview.hpp"
 #include <QApplication>
+#include <QFontDatabase>
+#include <QtAlgorithms>
+#include <QtConcurrentRun>
+#include <QtCore/qmath.h>
 #include <QPainter>
 #include <QPaintEvent>
 #include <QScrollBar>
 #include <QStyleOptionViewItem>
+#include <QTimer>
+#include <climits>
 
 
 namespace {
 const int ExtraHeight = 3;
+const int ExtraWidth = 10;
+const int NotDirty = INT_MAX;
+const int MeasureBatchSize = 5000;
+const int IdleMeasureSize = 250;
+
+
+QVector<int> measureTexts(const QFont &font, const QStringList &texts)
+{
+    QFontMetrics fm(font);
+    QVector<int> widths;
+    widths.reserve(texts.count());
+    foreach (const QString &text, texts)
+        widths << fm.width(text);
+    return widths;
 }
 
+} // anonymous namespace
+
 
 TiledListView::TiledListView(QWidget *parent)
     : QAbstractItemView(parent), idealWidth(0), idealHeight(0),
-      hashIsDirty(false)
+      rowHeight(1), firstDirtyRow(NotDirty), layoutWidth(-1),
+      measuringFrom(-1), measuringGeneration(0), generation(0)
 {
     setFocusPolicy(Qt::WheelFocus);
     setFont(QApplication::font("QListView"));
     horizontalScrollBar()->setRange(0, 0);
     verticalScrollBar()->setRange(0, 0);
+    connect(&measurer, SIGNAL(finished()), this, SLOT(measured()));
 }
 
 
 void TiledListView::setModel(QAbstractItemModel *model)
 {
+    if (QAbstractItemModel *oldModel = QAbstractItemView::model()) {
+        disconnect(oldModel,
+                SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
+                this, SLOT(rowsRemoved(const QModelIndex&, int, int)));
+        disconnect(oldModel, SIGNAL(layoutChanged()),
+                   this, SLOT(invalidateLayout()));
+    }
     QAbstractItemView::setModel(model);
-    hashIsDirty = true;
+    if (model) {
+        connect(model, SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
+                this, SLOT(rowsRemoved(const QModelIndex&, int, int)));
+        connect(model, SIGNAL(layoutChanged()),
+                this, SLOT(invalidateLayout()));
+    }
+    invalidateLayout();
 }
 
 
-#ifndef SQL_FRIENDLY
-void TiledListView::calculateRectsIfNecessary() const
+void TiledListView::reset()
 {
-    if (!hashIsDirty)
-        return;
-    const int ExtraWidth = 10;
-    QFontMetrics fm(font());
-    const int RowHeight = fm.height() + ExtraHeight;
-    const int MaxWidth = viewport()->width();
-    int minimumWidth = 0;
-    int x = 0;
-    int y = 0;
-    for (int row = 0; row < model()->rowCount(rootIndex()); ++row) {
-        QModelIndex index = model()->index(row, 0, rootIndex());
-        QString text = model()->data(index).toString();
-        int textWidth = fm.width(text);
-        if (!(x == 0 || x + textWidth + ExtraWidth < MaxWidth)) {
-            y += RowHeight;
-            x = 0;
-        }
-        else if (x != 0)
-            x += ExtraWidth;
-        rectForRow[row] = QRectF(x, y, textWidth + ExtraWidth,
-                                RowHeight);
-        if (textWidth > minimumWidth)
-            minimumWidth = textWidth;
-        x += textWidth;
-    }
-    idealWidth = minimumWidth + ExtraWidth;
-    idealHeight = y + RowHeight;
-    hashIsDirty = false;
-    viewport()->update();
+    invalidateLayout();
+    QAbstractItemView::reset();
+}
+
+
+// Forgets all the measured widths, e.g., after the model is sorted
+void TiledListView::invalidateLayout()
+{
+    textWidthForRow.clear();
+    ++generation;
+    relayoutFrom(0);
+}
+
+
+void TiledListView::relayoutFrom(int row) const
+{
+    firstDirtyRow = qMin(firstDirtyRow, row);
 }
-#else
-// This is only needed if we use a SQL-based model for a database that
-// doesn't report its query size.
-void TiledListView::calculateRectsIfNecessary() const
+
+
+// Rows up to throughRow and those whose lines fall in the viewport are
+// measured here; the layout stops at the first other row that hasn't
+// been measured and the rest are measured in the background. So if the
+// viewport is scrolled beyond the layout nothing above it is measured
+// here; the batches lay those rows out first.
+void TiledListView::calculateRectsIfNecessary(int throughRow) const
 {
-    if (!hashIsDirty)
+    const int MaxWidth = viewport()->width();
+    if (MaxWidth != layoutWidth) {
+        layoutWidth = MaxWidth;
+        relayoutFrom(0);
+    }
+    if (font() != layoutFont) {
+        layoutFont = font();
+        textWidthForRow.clear();
+        ++generation;
+        relayoutFrom(0);
+    }
+    if (firstDirtyRow == NotDirty)
         return;
-    const int ExtraWidth = 10;
     QFontMetrics fm(font());
-    const int RowHeight = fm.height() + ExtraHeight;
-    const int MaxWidth = viewport()->width();
-    int minimumWidth = 0;
+    rowHeight = fm.height() + ExtraHeight;
+
+    // Start again from the beginning of the line the first dirty row
+    // was on, keeping all the lines before it
+    int line = 0;
+    if (!firstRowOfLine.isEmpty())
+        line = qMax(0, lineForRow(firstDirtyRow));
+    int row = line < firstRowOfLine.count() ? firstRowOfLine.at(line) : 0;
+    firstRowOfLine.resize(line);
+    widestUpToLine.resize(line);
+    xForRow.resize(row);
+    widthForRow.resize(row);
+    int widest = line ? widestUpToLine.at(line - 1) : 0;
+    bool lineIsEmpty = true;
     int x = 0;
-    int y = 0;
-    int row = 0;
+    const int visibleTop = verticalScrollBar()->value();
+    const int visibleBottom = visibleTop + viewport()->height();
+    int rowCount;
     forever {
-        for (; row < model()->rowCount(rootIndex()); ++row) {
-            QModelIndex index = model()->index(row, 0, rootIndex());
-            QString text = model()->data(index).toString();
-            int textWidth = fm.width(text);
-            if (!(x == 0 || x + textWidth + ExtraWidth < MaxWidth)) {
-                y += RowHeight;
+        rowCount = model()->rowCount(rootIndex());
+        textWidthForRow.resize(qMin(textWidthForRow.count(), rowCount));
+        while (textWidthForRow.count() < rowCount)
+            textWidthForRow << -1;
+        xForRow.reserve(rowCount);
+        widthForRow.reserve(rowCount);
+        for (; row < rowCount; ++row) {
+            int textWidth = textWidthForRow.at(row);
+            if (textWidth < 0) {
+                const int y = (firstRowOfLine.count() -
+                               (lineIsEmpty ? 0 : 1)) * rowHeight;
+                if (row > throughRow && (y > visibleBottom ||
+                                         y + rowHeight <= visibleTop)) {
+                    measureInBackground(row);
+                    break;
+                }
+                QModelIndex index = model()->index(row, 0, rootIndex());
+                QString text = model()->data(index).toString();
+                textWidth = textWidthForRow[row] = fm.width(text);
+            }
+            if (!(lineIsEmpty || x + textWidth + ExtraWidth < MaxWidth)) {
+                widestUpToLine << widest;
+                lineIsEmpty = true;
                 x = 0;
             }
-            else if (x != 0)
+            else if (!lineIsEmpty)
                 x += ExtraWidth;
-            rectForRow[row] = QRectF(x, y, textWidth + ExtraWidth,
-                                    RowHeight);
-            if (textWidth > minimumWidth)
-                minimumWidth = textWidth;
+            if (lineIsEmpty) {
+                firstRowOfLine << row;
+                lineIsEmpty = false;
+            }
+            xForRow << x;
+            widthForRow << textWidth + ExtraWidth;
+            if (textWidth > widest)
+                widest = textWidth;
             x += textWidth;
         }
-        if (!model()->canFetchMore(rootIndex())) {
+        if (row < rowCount) // Being measured in the background
             break;
+#ifdef SQL_FRIENDLY
+        // This is only needed if we use a SQL-based model for a database
+        // that doesn't report its query size.
+        if (model()->canFetchMore(rootIndex())) {
+            model()->fetchMore(rootIndex());
+            continue;
         }
-        model()->fetchMore(rootIndex());
+#endif
+        break;
     }
-    idealWidth = minimumWidth + ExtraWidth;
-    idealHeight = y + RowHeight;
-    hashIsDirty = false;
+    if (!lineIsEmpty)
+        widestUpToLine << widest;
+    idealWidth = widest + ExtraWidth;
+    int lines = qMax(1, firstRowOfLine.count());
+    if (row < rowCount && row > 0) {
+        const qreal rowsPerLine = row / static_cast<qreal>(lines);
+        lines += qCeil((rowCount - row) / rowsPerLine);
+    }
+    idealHeight = lines * rowHeight;
+    firstDirtyRow = NotDirty;
     viewport()->update();
 }
-#endif
+
+
+void TiledListView::measureInBackground(int row) const
+{
+    if (measuringFrom != -1)
+        return; // measured() will carry on from where this batch ends
+    const int end = qMin(model()->rowCount(rootIndex()),
+                         row + MeasureBatchSize);
+    QStringList texts;
+    for (int i = row; i < end; ++i)
+        texts << model()->data(model()->index(i, 0, rootIndex()))
+                 .toString();
+    measuringFrom = row;
+    measuringGeneration = generation;
+    if (QFontDatabase::supportsThreadedFontRendering())
+        measurer.setFuture(QtConcurrent::run(measureTexts, font(),
+                                             texts));
+    else {
+        idleTexts = texts;
+        QTimer::singleShot(0, this, SLOT(measureWhenIdle()));
+    }
+}
+
+
+void TiledListView::measured()
+{
+    applyMeasuredWidths(measurer.result());
+}
+
+
+// Used instead of a worker thread where fonts can only be used in the
+// GUI thread; each call measures a few rows so the GUI stays responsive
+void TiledListView::measureWhenIdle()
+{
+    if (measuringFrom == -1)
+        return;
+    idleWidths += measureTexts(font(),
+            idleTexts.mid(idleWidths.count(), IdleMeasureSize));
+    if (idleWidths.count() < idleTexts.count()) {
+        QTimer::singleShot(0, this, SLOT(measureWhenIdle()));
+        return;
+    }
+    const QVector<int> widths = idleWidths;
+    idleTexts.clear();
+    idleWidths.clear();
+    applyMeasuredWidths(widths);
+}
+
+
+// A batch measured before the rows or their texts changed is thrown
+// away and the layout asks for a new one
+void TiledListView::applyMeasuredWidths(const QVector<int> &widths)
+{
+    const int from = measuringFrom;
+    measuringFrom = -1;
+    if (measuringGeneration == generation) {
+        const int count = qMin(widths.count(),
+                               textWidthForRow.count() - from);
+        for (int i = 0; i < count; ++i)
+            textWidthForRow[from + i] = widths.at(i);
+        relayoutFrom(from);
+    }
+    else
+        relayoutFrom(xForRow.count());
+    calculateRectsIfNecessary();
+    updateGeometries();
+}
+
 
 QRect TiledListView::visualRect(const QModelIndex &index) const
 {
@@ -128,10 +280,23 @@ QRect TiledListView::visualRect(const QModelIndex &index) const
 }
 
 
+// In content coordinates; invalid for rows that haven't been laid out
+QRectF TiledListView::rectForRow(int row) const
+{
+    if (row < 0 || row >= xForRow.count())
+        return QRectF();
+    return QRectF(xForRow.at(row), lineForRow(row) * rowHeight,
+                  widthForRow.at(row), rowHeight);
+}
+
+
 QRectF TiledListView::viewportRectForRow(int row) const
 {
-    calculateRectsIfNecessary();
-    QRectF rect = rectForRow.value(row).toRect();
+    // A row the background layout hasn't reached yet is laid out now
+    if (row >= xForRow.count() && row < model()->rowCount(rootIndex()))
+        relayoutFrom(xForRow.count());
+    calculateRectsIfNecessary(row);
+    QRectF rect = rectForRow(row).toRect();
     if (!rect.isValid())
         return rect;
     return QRectF(rect.x() - horizontalScrollBar()->value(),
@@ -140,11 +305,72 @@ QRectF TiledListView::viewportRectForRow(int row) const
 }
 
 
+int TiledListView::lineForRow(int row) const
+{
+    return qUpperBound(firstRowOfLine.constBegin(),
+                       firstRowOfLine.constEnd(), row) -
+           firstRowOfLine.constBegin() - 1;
+}
+
+
+// Returns the row whose tile contains the point (in content
+// coordinates) or -1
+int TiledListView::rowAt(const QPoint &point) const
+{
+    if (point.y() < 0)
+        return -1;
+    const int line = point.y() / rowHeight;
+    int first;
+    int last;
+    if (!rowsInLine(line, point.x(), point.x(), &first, &last))
+        return -1;
+    return first;
+}
+
+
+// Finds the rows in the line whose tiles overlap the span from left to
+// right inclusive; returns false if there are none
+bool TiledListView::rowsInLine(int line, qreal left, qreal right,
+                               int *first, int *last) const
+{
+    if (line < 0 || line >= firstRowOfLine.count())
+        return false;
+    const QVector<int>::const_iterator begin = xForRow.constBegin() +
+            firstRowOfLine.at(line);
+    const QVector<int>::const_iterator end = xForRow.constBegin() +
+            (line + 1 < firstRowOfLine.count()
+             ? firstRowOfLine.at(line + 1) : xForRow.count());
+    QVector<int>::const_iterator i = qUpperBound(begin, end,
+            static_cast<int>(qFloor(left)));
+    if (i != begin)
+        --i;
+    int row = i - xForRow.constBegin();
+    if (xForRow.at(row) + widthForRow.at(row) < left)
+        ++row;
+    *first = row;
+    *last = qUpperBound(begin, end, static_cast<int>(qFloor(right))) -
+            xForRow.constBegin() - 1;
+    return *first <= *last;
+}
+
+
+// Finds the lines that overlap the span from top to bottom inclusive;
+// first is greater than last if there are none
+void TiledListView::linesBetween(qreal top, qreal bottom, int *first,
+                                 int *last) const
+{
+    *first = qMax(0, static_cast<int>(qFloor(top / rowHeight)));
+    *last = qMin(firstRowOfLine.count() - 1,
+                 static_cast<int>(qFloor(bottom / rowHeight)));
+}
+
+
 void TiledListView::scrollTo(const QModelIndex &index,
                              QAbstractItemView::ScrollHint)
 {
     QRect viewRect = viewport()->rect();
     QRect itemRect = visualRect(index);
+    updateGeometries(); // In case index's row has just been laid out
 
     if (itemRect.left() < viewRect.left())
         horizontalScrollBar()->setValue(horizontalScrollBar()->value()
@@ -170,37 +396,52 @@ QModelIndex TiledListView::indexAt(const QPoint &point_) const
     point.rx() += horizontalScrollBar()->value();
     point.ry() += verticalScrollBar()->value();
     calculateRectsIfNecessary();
-    QHashIterator<int, QRectF> i(rectForRow);
-    while (i.hasNext()) {
-        i.next();
-        if (i.value().contains(point))
-            return model()->index(i.key(), 0, rootIndex());
-    }
-    return QModelIndex();
+    const int row = rowAt(point);
+    if (row == -1)
+        return QModelIndex();
+    return model()->index(row, 0, rootIndex());
 }
 
 
 void TiledListView::dataChanged(const QModelIndex &topLeft,
-                                const QModelIndex &bottomRight)
+        const QModelIndex &bottomRight,
+        const QVector<int> &roles) //roles added for Qt5
 {
-    hashIsDirty = true;
-    QAbstractItemView::dataChanged(topLeft, bottomRight);
+    if (topLeft.parent() == rootIndex()) {
+        const int last = qMin(bottomRight.row(),
+                              textWidthForRow.count() - 1);
+        for (int row = topLeft.row(); row <= last; ++row)
+            textWidthForRow[row] = -1;
+        ++generation;
+        relayoutFrom(topLeft.row());
+    }
+    QAbstractItemView::dataChanged(topLeft, bottomRight, roles);
 }
 
 
 void TiledListView::rowsInserted(const QModelIndex &parent, int start,
                                  int end)
 {
-    hashIsDirty = true;
+    if (parent == rootIndex()) {
+        if (start <= textWidthForRow.count())
+            textWidthForRow.insert(start, end - start + 1, -1);
+        ++generation;
+        relayoutFrom(start);
+    }
     QAbstractItemView::rowsInserted(parent, start, end);
 }
 
 
-void TiledListView::rowsAboutToBeRemoved(const QModelIndex &parent,
-                                         int start, int end)
+void TiledListView::rowsRemoved(const QModelIndex &parent, int start,
+                                int end)
 {
-    hashIsDirty = true;
-    QAbstractItemView::rowsAboutToBeRemoved(parent, start, end);
+    if (parent == rootIndex()) {
+        if (start < textWidthForRow.count())
+            textWidthForRow.remove(start,
+                    qMin(end + 1, textWidthForRow.count()) - start);
+        ++generation;
+        relayoutFrom(start);
+    }
 }
 
 
@@ -273,17 +514,32 @@ void TiledListView::setSelection(const QRect &rect,
     QRect rectangle = rect.translated(horizontalScrollBar()->value(),
             verticalScrollBar()->value()).normalized();
     calculateRectsIfNecessary();
-    QHashIterator<int, QRectF> i(rectForRow);
-    int firstRow = model()->rowCount();
+    // Tiles are in row order, so the first row is in the highest line
+    // with any tiles in the rectangle and the last row in the lowest
+    int firstLine;
+    int lastLine;
+    linesBetween(rectangle.top(), rectangle.bottom(), &firstLine,
+                 &lastLine);
+    int firstRow = -1;
     int lastRow = -1;
-    while (i.hasNext()) {
-        i.next();
-        if (i.value().intersects(rectangle)) {
-            firstRow = firstRow < i.key() ? firstRow : i.key();
-            lastRow = lastRow > i.key() ? lastRow : i.key();
+    int first;
+    int last;
+    for (int line = firstLine; line <= lastLine; ++line) {
+        if (rowsInLine(line, rectangle.left(), rectangle.right(),
+                       &first, &last)) {
+            firstRow = first;
+            break;
+        }
+    }
+    for (int line = lastLine; firstRow != -1 && line >= firstLine;
+         --line) {
+        if (rowsInLine(line, rectangle.left(), rectangle.right(),
+                       &first, &last)) {
+            lastRow = last;
+            break;
         }
     }
-    if (firstRow != model()->rowCount() && lastRow != -1) {
+    if (firstRow != -1 && lastRow != -1) {
         QItemSelection selection(
                 model()->index(firstRow, 0, rootIndex()),
                 model()->index(lastRow, 0, rootIndex()));
@@ -316,26 +572,56 @@ QRegion TiledListView::visualRegionForSelection(
 }
 
 
-void TiledListView::paintEvent(QPaintEvent*)
+// Only the tiles in the lines that overlap the exposed rectangle are
+// painted
+void TiledListView::paintEvent(QPaintEvent *event)
 {
     QPainter painter(viewport());
     painter.setRenderHints(QPainter::Antialiasing|
                            QPainter::TextAntialiasing);
-    for (int row = 0; row < model()->rowCount(rootIndex()); ++row) {
-        QModelIndex index = model()->index(row, 0, rootIndex());
-        QRectF rect = viewportRectForRow(row);
-        if (!rect.isValid() || rect.bottom() < 0 ||
-            rect.y() > viewport()->height())
+    calculateRectsIfNecessary();
+    const QRect exposed = event->rect().translated(
+            horizontalScrollBar()->value(), verticalScrollBar()->value());
+    int firstLine;
+    int lastLine;
+    linesBetween(exposed.top(), exposed.bottom(), &firstLine, &lastLine);
+    for (int line = firstLine; line <= lastLine; ++line) {
+        int first;
+        int last;
+        if (!rowsInLine(line, exposed.left(), exposed.right(), &first,
+                        &last))
             continue;
-        QStyleOptionViewItem option = viewOptions();
-        option.rect = rect.toRect();
-        if (selectionModel()->isSelected(index))
-            option.state |= QStyle::State_Selected;
-        if (currentIndex() == index)
-            option.state |= QStyle::State_HasFocus;
-        itemDelegate()->paint(&painter, option, index);
-        paintOutline(&painter, rect);
+        for (int row = first; row <= last; ++row) {
+            QModelIndex index = model()->index(row, 0, rootIndex());
+            QRectF rect = viewportRectForRow(row);
+            QStyleOptionViewItem option = viewOptions();
+            option.rect = rect.toRect();
+            if (selectionModel()->isSelected(index))
+                option.state |= QStyle::State_Selected;
+            if (currentIndex() == index)
+                option.state |= QStyle::State_HasFocus;
+            itemDelegate()->paint(&painter, option, index);
+            paintOutline(&painter, rect);
+        }
     }
+    paintPlaceholders(&painter, exposed);
+}
+
+
+// Lines below the layout are still being measured in the background
+void TiledListView::paintPlaceholders(QPainter *painter,
+                                      const QRect &exposed)
+{
+    if (xForRow.count() >= model()->rowCount(rootIndex()))
+        return;
+    const int first = qMax(firstRowOfLine.count(),
+                           exposed.top() / rowHeight);
+    const int last = qMin(exposed.bottom(), idealHeight - 1) / rowHeight;
+    const QBrush brush = palette().alternateBase();
+    for (int line = first; line <= last; ++line)
+        painter->fillRect(QRectF(0,
+                line * rowHeight - verticalScrollBar()->value() + 1,
+                viewport()->width(), rowHeight - 2), brush);
 }
 
 
@@ -355,7 +641,6 @@ void TiledListView::paintOutline(QPainter *painter,
 
 void TiledListView::resizeEvent(QResizeEvent*)
 {
-    hashIsDirty = true;
     calculateRectsIfNecessary();
     updateGeometries();
 }
@@ -14,10 +14,35 @@
 */
 
 #include <QAbstractItemView>
-#include <QHash>
+#include <QFont>
+#include <QFutureWatcher>
 #include <QRectF>
+#include <QStringList>
+#include <QVector>
 
 
+// The tiles are laid out in lines of equal height, so the layout is
+// kept as the first row of each line, in y order, and each row's x and
+// width. Finding the tile at a point, or the tiles in a rectangle, is a
+// binary search for the line(s) and then for the x within each line.
+//
+// Each row's text width is measured once and cached until the row's
+// data changes. Since a row's tile only depends on the rows before it,
+// changes only re-flow the tiles from the start of the line that holds
+// the first changed row, so edits near the end, or rows appended by
+// fetchMore(), don't touch the lines above them.
+//
+// Measuring text is what makes laying out a big model slow, so only
+// the rows that land in the viewport (or those up to a row that's
+// asked for) are measured in the GUI thread. The rest are measured in
+// batches in a worker thread, each batch's tiles being laid out when
+// it arrives, and until they're all done the scroll range is
+// estimated from the rows laid out so far. (On platforms that can't
+// render fonts outside the GUI thread the batches are measured in the
+// GUI thread instead, a few rows at a time whenever it's idle.) If the
+// viewport is scrolled past the laid out lines, placeholders are
+// painted there until the batches catch up.
+
 class TiledListView : public QAbstractItemView
 {
     Q_OBJECT
@@ -31,14 +56,22 @@ public:
                   QAbstractItemView::ScrollHint);
     QModelIndex indexAt(const QPoint &point_) const;
 
+public slots:
+    void reset();
+
 protected slots:
     void dataChanged(const QModelIndex &topLeft,
-                     const QModelIndex &bottomRight);
+                     const QModelIndex &bottomRight,
+                     const QVector<int> &roles=QVector<int>());
     void rowsInserted(const QModelIndex &parent, int start, int end);
-    void rowsAboutToBeRemoved(const QModelIndex &parent, int start,
-                              int end);
     void updateGeometries();
 
+private slots:
+    void rowsRemoved(const QModelIndex &parent, int start, int end);
+    void invalidateLayout();
+    void measured();
+    void measureWhenIdle();
+
 protected:
     QModelIndex moveCursor(
             QAbstractItemView::CursorAction cursorAction,
@@ -52,19 +85,43 @@ protected:
     QRegion visualRegionForSelection(
             const QItemSelection &selection) const;
 
-    void paintEvent(QPaintEvent*);
+    void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent*);
     void mousePressEvent(QMouseEvent *event);
 
 private:
-    void calculateRectsIfNecessary() const;
+    void calculateRectsIfNecessary(int throughRow=-1) const;
+    void relayoutFrom(int row) const;
+    void measureInBackground(int row) const;
+    void applyMeasuredWidths(const QVector<int> &widths);
+    QRectF rectForRow(int row) const;
     QRectF viewportRectForRow(int row) const;
+    int lineForRow(int row) const;
+    int rowAt(const QPoint &point) const;
+    bool rowsInLine(int line, qreal left, qreal right, int *first,
+                    int *last) const;
+    void linesBetween(qreal top, qreal bottom, int *first,
+                      int *last) const;
     void paintOutline(QPainter *painter, const QRectF &rectangle);
+    void paintPlaceholders(QPainter *painter, const QRect &exposed);
 
     mutable int idealWidth;
     mutable int idealHeight;
-    mutable QHash<int, QRectF> rectForRow;
-    mutable bool hashIsDirty;
+    mutable int rowHeight;
+    mutable QVector<int> firstRowOfLine;
+    mutable QVector<int> xForRow;
+    mutable QVector<int> widthForRow;
+    mutable QVector<int> widestUpToLine;
+    mutable QVector<int> textWidthForRow; // -1 if not yet measured
+    mutable int firstDirtyRow;
+    mutable int layoutWidth;
+    mutable QFont layoutFont;
+    mutable QFutureWatcher<QVector<int> > measurer;
+    mutable int measuringFrom; // -1 if no batch is being measured
+    mutable int measuringGeneration;
+    mutable int generation; // Changes whenever rows or texts change
+    mutable QStringList idleTexts; // Only used when measuring when idle
+    QVector<int> idleWidths;
 };
 
 #endif // TILEDLISTVIEW_HPP
@@ -2,5 +2,5 @@ CONFIG	    += console debug
 HEADERS	    += tiledlistview.hpp
 SOURCES     += tiledlistview.cpp
 SOURCES     += main.cpp
-QT += widgets #added for Qt5
+QT += widgets concurrent #added for Qt5
 #DEFINES	    += SQL_FRIENDLY
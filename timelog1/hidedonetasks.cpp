@@ -0,0 +1,43 @@
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include "hidedonetasks.hpp"
+#include <QStack>
+#include <QTreeView>
+
+
+void hideOrShowDoneTasks(QTreeView *treeView, bool hide)
+{
+    QAbstractItemModel *model = treeView->model();
+    if (!model)
+        return;
+    const bool updatesEnabled = treeView->updatesEnabled();
+    treeView->setUpdatesEnabled(false);
+    QStack<QModelIndex> parents;
+    parents.push(QModelIndex());
+    while (!parents.isEmpty()) {
+        const QModelIndex parent = parents.pop();
+        const int rows = model->rowCount(parent);
+        for (int row = 0; row < rows; ++row) {
+            const QModelIndex index = model->index(row, 0, parent);
+            const bool hideThisOne = hide &&
+                    index.data(Qt::CheckStateRole).toInt() == Qt::Checked;
+            if (treeView->isRowHidden(row, parent) != hideThisOne)
+                treeView->setRowHidden(row, parent, hideThisOne);
+            // The subtasks of a hidden task are hidden with it
+            if (!hideThisOne && model->hasChildren(index))
+                parents.push(index);
+        }
+    }
+    treeView->setUpdatesEnabled(updatesEnabled);
+}
@@ -0,0 +1,28 @@
+#ifndef HIDEDONETASKS_HPP
+#define HIDEDONETASKS_HPP
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+class QTreeView;
+
+
+// Hides every done task in the tree view, and with it all its subtasks,
+// or shows all the tasks again. The model is walked in a single pass
+// without recursion, setRowHidden() is only called for rows whose
+// hidden state actually changes, and the view isn't repainted until
+// the pass is done, so the view lays itself out just once. Works with
+// any model whose column 0 items are checked when they're done.
+
+void hideOrShowDoneTasks(QTreeView *treeView, bool hide);
+
+#endif // HIDEDONETASKS_HPP
@@ -14,6 +14,7 @@
 #include "alt_key.hpp"
 #include "aqp.hpp"
 #include "global.hpp"
+#include "hidedonetasks.hpp"
 #include "mainwindow.hpp"
 #include "richtextdelegate.hpp"
 #ifdef CUSTOM_MODEL
@@ -55,6 +56,11 @@ const int StatusTimeout = AQP::MSecPerSecond * 10;
 const QString FilenameSetting("Filename");
 const QString GeometrySetting("Geometry");
 const QString CurrentTaskPathSetting("CurrentTaskPath");
+#ifdef CUSTOM_MODEL
+const QString FileSuffix(".tlj"); // Journals; .tlg files are imported
+#else
+const QString FileSuffix(".tlg");
+#endif
 const int FirstFrame = 0;
 const int LastFrame = 4;
 
@@ -146,6 +152,10 @@ void MainWindow::createActions()
             , QKeySequence::SaveAs
 #endif
             );
+#ifdef CUSTOM_MODEL
+    fileExportAction = createAction(":/filesave.png",
+            tr("Export as XML..."), this);
+#endif
     fileQuitAction = createAction(":/filequit.png", tr("Quit"), this);
 #if QT_VERSION >= 0x040600
     fileQuitAction->setShortcuts(QKeySequence::Quit);
@@ -198,6 +208,10 @@ void MainWindow::createMenusAndToolBar()
         if (action == fileSaveAction || action == fileSaveAsAction)
             action->setEnabled(false);
     }
+#ifdef CUSTOM_MODEL
+    fileMenu->addAction(fileExportAction);
+    fileExportAction->setEnabled(false);
+#endif
     fileMenu->addSeparator();
     fileMenu->addAction(fileQuitAction);
 
@@ -258,6 +272,9 @@ void MainWindow::createConnections()
     slotForAction[fileOpenAction] = SLOT(fileOpen());
     slotForAction[fileSaveAction] = SLOT(fileSave());
     slotForAction[fileSaveAsAction] = SLOT(fileSaveAs());
+#ifdef CUSTOM_MODEL
+    slotForAction[fileExportAction] = SLOT(fileExport());
+#endif
     slotForAction[fileQuitAction] = SLOT(close());
     slotForAction[editAddAction] = SLOT(editAdd());
     slotForAction[editDeleteAction] = SLOT(editDelete());
@@ -341,6 +358,7 @@ void MainWindow::updateUi()
 #endif
         action->setEnabled(enable);
 #ifdef CUSTOM_MODEL
+    fileExportAction->setEnabled(rows);
     editStartOrStopAction->setEnabled(rows);
     editPasteAction->setEnabled(model->hasCutItem());
 #endif
@@ -356,7 +374,11 @@ void MainWindow::fileOpen()
                 : QFileInfo(filename).canonicalPath());
     filename = QFileDialog::getOpenFileName(this,
             tr("%1 - Open").arg(QApplication::applicationName()),
+#ifdef CUSTOM_MODEL
+            dir, tr("Timelogs (*.tlj *.tlg)"));
+#else
             dir, tr("Timelogs (*.tlg)"));
+#endif
     if (!filename.isEmpty())
         load(filename);
 }
@@ -439,16 +461,45 @@ bool MainWindow::fileSaveAs()
     filename = QFileDialog::getSaveFileName(this,
             tr("%1 - Save As").arg(QApplication::applicationName()),
             dir,
-            tr("%1 (*.tlg)").arg(QApplication::applicationName()));
+            tr("%1 (*%2)").arg(QApplication::applicationName())
+                          .arg(FileSuffix));
     if (filename.isEmpty())
         return false;
-    if (!filename.toLower().endsWith(".tlg"))
-        filename += ".tlg";
+    if (!filename.endsWith(FileSuffix, Qt::CaseInsensitive))
+        filename += FileSuffix;
     model->setFilename(filename);
     return fileSave();
 }
 
 
+#ifdef CUSTOM_MODEL
+// Writes the tasks in the original XML format; the model's own file is
+// unaffected
+void MainWindow::fileExport()
+{
+    QString filename = model->filename();
+    QString dir = filename.isEmpty() ? "."
+                                     : QFileInfo(filename).path();
+    filename = QFileDialog::getSaveFileName(this,
+            tr("%1 - Export as XML").arg(QApplication::applicationName()),
+            dir, tr("XML (*.xml)"));
+    if (filename.isEmpty())
+        return;
+    if (!filename.toLower().endsWith(".xml"))
+        filename += ".xml";
+    try {
+        model->exportXml(filename);
+        statusBar()->showMessage(tr("Exported %1").arg(filename),
+                                 StatusTimeout);
+    } catch (AQP::Error &error) {
+        AQP::warning(this, tr("Error"),
+                tr("Failed to export %1: %2").arg(filename)
+                .arg(QString::fromUtf8(error.what())));
+    }
+}
+#endif
+
+
 #ifndef CUSTOM_MODEL
 void MainWindow::editAdd()
 {
@@ -529,6 +580,7 @@ void MainWindow::editDelete()
         stopTiming();
     QString name = item->text();
     int rows = item->rowCount();
+    QStandardItem *parentItem = item->parent();
 #endif
     QString message;
     if (rows == 0)
@@ -542,6 +594,9 @@ void MainWindow::editDelete()
     if (!AQP::okToDelete(this, tr("Delete"), message))
         return;
     model->removeRow(index.row(), index.parent());
+#ifndef CUSTOM_MODEL
+    model->calculateTotalsUpFrom(parentItem);
+#endif
     setDirty();
     updateUi();
 }
@@ -679,13 +734,22 @@ void MainWindow::timeout()
     timedTime.restart();
 #else
     Q_ASSERT(timedItem);
-    timedItem->incrementLastEndTime(timedTime.elapsed());
+    const int minutes = timedItem->incrementLastEndTime(
+            timedTime.elapsed());
     timedTime.restart();
-    StandardItem *item = timedItem;
-    while (item) {
-        item->todayItem()->setText(item->todaysTime());
-        item->totalItem()->setText(item->totalTime());
-        item = static_cast<StandardItem*>(item->parent());
+    const QDate today = QDate::currentDate();
+    if (model->totalsDate() != today) // It's gone midnight
+        model->calculateTotals();
+    else if (minutes) {
+        // Only the timed item's last date/time has changed, so every
+        // total from it up to the root changes by the same amount
+        const bool addToToday =
+                timedItem->dateTimes().last().first.date() == today;
+        StandardItem *item = timedItem;
+        while (item) {
+            item->addMinutes(minutes, addToToday);
+            item = static_cast<StandardItem*>(item->parent());
+        }
     }
 #endif
 }
@@ -711,38 +775,5 @@ void MainWindow::updateIcon(int frame)
 
 void MainWindow::editHideOrShowDoneTasks(bool hide)
 {
-#ifdef CUSTOM_MODEL
-    hideOrShowDoneTask(hide, QModelIndex());
-#else
-    hideOrShowDoneTask(hide, model->invisibleRootItem());
-#endif
+    hideOrShowDoneTasks(treeView, hide);
 }
-
-#ifndef CUSTOM_MODEL
-void MainWindow::hideOrShowDoneTask(bool hide, QStandardItem *item)
-{
-    QModelIndex index = item->parent() ? item->parent()->index()
-                                       : QModelIndex();
-    bool hideThisOne = hide && (item->checkState() == Qt::Checked);
-    treeView->setRowHidden(item->row(), index, hideThisOne);
-    if (!hideThisOne) {
-        for (int row = 0; row < item->rowCount(); ++row)
-            hideOrShowDoneTask(hide, item->child(row, 0));
-    }
-}
-
-#else
-
-void MainWindow::hideOrShowDoneTask(bool hide,
-                                    const QModelIndex &index)
-{
-    bool hideThisOne = hide && model->isChecked(index);
-    if (index.isValid())
-        treeView->setRowHidden(index.row(), index.parent(),
-                               hideThisOne);
-    if (!hideThisOne) {
-        for (int row = 0; row < model->rowCount(index); ++row)
-            hideOrShowDoneTask(hide, model->index(row, 0, index));
-    }
-}
-#endif
@@ -20,7 +20,6 @@
 
 
 class QAction;
-class QStandardItem;
 class StandardItem;
 class QModelIndex;
 class QTreeView;
@@ -49,6 +48,9 @@ private slots:
     void fileOpen();
     bool fileSave();
     bool fileSaveAs();
+#ifdef CUSTOM_MODEL
+    void fileExport();
+#endif
     void editAdd();
     void editDelete();
 #ifdef CUSTOM_MODEL
@@ -75,16 +77,14 @@ private:
     void createConnections();
     bool okToClearData();
     void setCurrentIndex(const QModelIndex &index);
-#ifdef CUSTOM_MODEL
-    void hideOrShowDoneTask(bool hide, const QModelIndex &index);
-#else
-    void hideOrShowDoneTask(bool hide, QStandardItem *item);
-#endif
 
     QAction *fileNewAction;
     QAction *fileOpenAction;
     QAction *fileSaveAction;
     QAction *fileSaveAsAction;
+#ifdef CUSTOM_MODEL
+    QAction *fileExportAction;
+#endif
     QAction *fileQuitAction;
     QAction *editAddAction;
     QAction *editDeleteAction;
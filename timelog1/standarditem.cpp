@@ -14,8 +14,25 @@
 #include "standarditem.hpp"
 
 
+namespace {
+
+int minutesFor(const QPair<QDateTime, QDateTime> &dateTime)
+{
+    return dateTime.first.secsTo(dateTime.second) / 60;
+}
+
+
+QString hoursAndMinutes(int minutes)
+{
+    return QString("%1:%2").arg(minutes / 60)
+                           .arg(minutes % 60, 2, 10, QChar('0'));
+}
+
+} // anonymous namespace
+
+
 StandardItem::StandardItem(const QString &text, bool done)
-    : QStandardItem(text)
+    : QStandardItem(text), m_todaysMinutes(0), m_totalMinutes(0)
 {
     setCheckable(true);
     setCheckState(done ? Qt::Checked : Qt::Unchecked);
@@ -30,46 +47,65 @@ StandardItem::StandardItem(const QString &text, bool done)
 }
 
 
-void StandardItem::incrementLastEndTime(int msec)
+// Returns how many whole minutes the last date/time has grown by
+int StandardItem::incrementLastEndTime(int msec)
 {
     Q_ASSERT(!m_dateTimes.isEmpty());
-    QDateTime &endTime = m_dateTimes.last().second;
+    QPair<QDateTime, QDateTime> &dateTime = m_dateTimes.last();
+    const int oldMinutes = minutesFor(dateTime);
+    QDateTime &endTime = dateTime.second;
     endTime.setTime(endTime.time().addMSecs(msec));
+    return minutesFor(dateTime) - oldMinutes;
 }
 
 
 QString StandardItem::todaysTime() const
 {
-    int minutes = minutesForTask(true);
-    return QString("%1:%2").arg(minutes / 60)
-                           .arg(minutes % 60, 2, 10, QChar('0'));
+    return hoursAndMinutes(m_todaysMinutes);
 }
 
 
 QString StandardItem::totalTime() const
 {
-    int minutes = minutesForTask(false);
-    return QString("%1:%2").arg(minutes / 60)
-                           .arg(minutes % 60, 2, 10, QChar('0'));
+    return hoursAndMinutes(m_totalMinutes);
 }
 
 
-int StandardItem::minutesForTask(bool onlyForToday) const
+// Assumes that the children's times are already up to date
+void StandardItem::calculateTimes()
 {
-    int minutes = 0;
+    const QDate today = QDate::currentDate();
+    m_todaysMinutes = m_totalMinutes = 0;
     QListIterator<QPair<QDateTime, QDateTime> > i(m_dateTimes);
     while (i.hasNext()) {
         const QPair<QDateTime, QDateTime> &dateTime = i.next();
-        if (onlyForToday &&
-            dateTime.first.date() != QDate::currentDate())
-            continue;
-        minutes += (dateTime.first.secsTo(dateTime.second) / 60);
+        const int minutes = minutesFor(dateTime);
+        m_totalMinutes += minutes;
+        if (dateTime.first.date() == today)
+            m_todaysMinutes += minutes;
     }
     for (int row = 0; row < rowCount(); ++row) {
         StandardItem *item = static_cast<StandardItem*>(child(row,
                                                               0));
         Q_ASSERT(item);
-        minutes += item->minutesForTask(onlyForToday);
+        m_todaysMinutes += item->m_todaysMinutes;
+        m_totalMinutes += item->m_totalMinutes;
     }
-    return minutes;
+    updateTexts();
+}
+
+
+void StandardItem::addMinutes(int minutes, bool today)
+{
+    m_totalMinutes += minutes;
+    if (today)
+        m_todaysMinutes += minutes;
+    updateTexts();
+}
+
+
+void StandardItem::updateTexts()
+{
+    m_today->setText(todaysTime());
+    m_total->setText(totalTime());
 }
@@ -19,6 +19,11 @@
 #include <QStandardItem>
 
 
+// The Today and Total texts show cached minute counts for the item and
+// all its descendants. They are computed from scratch by
+// calculateTimes() and adjusted by addMinutes() when only the timed
+// item's last date/time has grown.
+
 class StandardItem : public QStandardItem
 {
 public:
@@ -30,17 +35,21 @@ public:
         { m_dateTimes << qMakePair(start, end); }
     QList<QPair<QDateTime, QDateTime> > dateTimes() const
         { return m_dateTimes; }
-    void incrementLastEndTime(int msec);
+    int incrementLastEndTime(int msec);
 
     QString todaysTime() const;
     QString totalTime() const;
+    void calculateTimes();
+    void addMinutes(int minutes, bool today);
 
 private:
-    int minutesForTask(bool onlyForToday) const;
+    void updateTexts();
 
     QStandardItem *m_today;
     QStandardItem *m_total;
     QList<QPair<QDateTime, QDateTime> > m_dateTimes;
+    int m_todaysMinutes;
+    int m_totalMinutes;
 };
 
 #endif // STANDARDITEM_HPP
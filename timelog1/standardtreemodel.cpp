@@ -92,7 +92,7 @@ void StandardTreeModel::load(const QString &filename)
     if (stack.count() != 1 || stack.top() != invisibleRootItem())
         throw AQP::Error(tr("loading error: possibly corrupt file"));
 
-    calculateTotalsFor(invisibleRootItem());
+    calculateTotals();
 }
 
 
@@ -169,15 +169,31 @@ QStandardItem *StandardTreeModel::itemForPath(QStandardItem *root,
 }
 
 
+void StandardTreeModel::calculateTotals()
+{
+    m_totalsDate = QDate::currentDate();
+    calculateTotalsFor(invisibleRootItem());
+}
+
+
+// Children first, so each item just adds up its children's totals
 void StandardTreeModel::calculateTotalsFor(QStandardItem *root)
 {
-    if (root != invisibleRootItem()) {
-        StandardItem *item = static_cast<StandardItem*>(root);
-        item->todayItem()->setText(item->todaysTime());
-        item->totalItem()->setText(item->totalTime());
-    }
     for (int row = 0; row < root->rowCount(); ++row)
         calculateTotalsFor(root->child(row, 0));
+    if (root != invisibleRootItem())
+        static_cast<StandardItem*>(root)->calculateTimes();
+}
+
+
+// For when an item's children have changed: only the item and its
+// ancestors need their totals recalculated
+void StandardTreeModel::calculateTotalsUpFrom(QStandardItem *item)
+{
+    while (item && item != invisibleRootItem()) {
+        static_cast<StandardItem*>(item)->calculateTimes();
+        item = item->parent();
+    }
 }
 
 
@@ -13,6 +13,7 @@
     the GNU General Public License for more details.
 */
 
+#include <QDate>
 #include <QStandardItemModel>
 // Mac needs these included this way---and needs them in the header
 #include <QtCore/QXmlStreamReader>
@@ -42,6 +43,9 @@ public:
                                  const QModelIndex &index);
     QStringList pathForIndex(const QModelIndex &index) const;
     QStandardItem *itemForPath(const QStringList &path) const;
+    QDate totalsDate() const { return m_totalsDate; }
+    void calculateTotals();
+    void calculateTotalsUpFrom(QStandardItem *item);
 
 private:
     void initialize();
@@ -54,6 +58,7 @@ private:
                               QStandardItem *item);
 
     QString m_filename;
+    QDate m_totalsDate;
 };
 
 
@@ -16,6 +16,8 @@ HEADERS	    += standarditem.hpp
 SOURCES	    += standarditem.cpp
 HEADERS	    += standardtreemodel.hpp
 SOURCES     += standardtreemodel.cpp
+HEADERS	    += hidedonetasks.hpp
+SOURCES	    += hidedonetasks.cpp
 HEADERS	    += mainwindow.hpp
 SOURCES     += mainwindow.cpp
 SOURCES     += main.cpp
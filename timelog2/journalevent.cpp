@@ -0,0 +1,68 @@
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include "journalevent.hpp"
+
+
+// Only the fields that the event's type uses are written
+QDataStream &operator<<(QDataStream &out, const JournalEvent &event)
+{
+    out << static_cast<quint8>(event.type) << event.id;
+    switch (event.type) {
+        case JournalEvent::AddTask:
+            out << event.parentId << event.row << event.name
+                << event.done;
+            break;
+        case JournalEvent::RemoveTask: break;
+        case JournalEvent::MoveTask:
+            out << event.parentId << event.row;
+            break;
+        case JournalEvent::RenameTask: out << event.name; break;
+        case JournalEvent::SetTaskDone: out << event.done; break;
+        case JournalEvent::AddDateTime:
+            out << event.start << event.end;
+            break;
+        case JournalEvent::SetLastEndTime: out << event.end; break;
+        default: Q_ASSERT(false);
+    }
+    return out;
+}
+
+
+// Sets the stream's status to ReadCorruptData for an unknown type
+QDataStream &operator>>(QDataStream &in, JournalEvent &event)
+{
+    quint8 type;
+    in >> type >> event.id;
+    event.type = static_cast<JournalEvent::Type>(type);
+    switch (event.type) {
+        case JournalEvent::AddTask:
+            in >> event.parentId >> event.row >> event.name
+               >> event.done;
+            break;
+        case JournalEvent::RemoveTask: break;
+        case JournalEvent::MoveTask:
+            in >> event.parentId >> event.row;
+            break;
+        case JournalEvent::RenameTask: in >> event.name; break;
+        case JournalEvent::SetTaskDone: in >> event.done; break;
+        case JournalEvent::AddDateTime:
+            in >> event.start >> event.end;
+            break;
+        case JournalEvent::SetLastEndTime: in >> event.end; break;
+        default:
+            if (in.status() == QDataStream::Ok)
+                in.setStatus(QDataStream::ReadCorruptData);
+    }
+    return in;
+}
@@ -0,0 +1,47 @@
+#ifndef JOURNALEVENT_HPP
+#define JOURNALEVENT_HPP
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QString>
+
+
+// One change to the task tree, as recorded in a timelog journal. Tasks
+// are identified by ids that stay the same for as long as the task
+// exists; id 0 is the (invisible) root.
+
+struct JournalEvent
+{
+    enum Type {AddTask=1, RemoveTask, MoveTask, RenameTask, SetTaskDone,
+               AddDateTime, SetLastEndTime};
+
+    explicit JournalEvent(Type type_=AddTask, quint32 id_=0)
+        : type(type_), id(id_), parentId(0), row(0), done(false) {}
+
+    Type type;
+    quint32 id;
+    quint32 parentId; // AddTask and MoveTask
+    qint32 row; // AddTask and MoveTask
+    QString name; // AddTask and RenameTask
+    bool done; // AddTask and SetTaskDone
+    QDateTime start; // AddDateTime
+    QDateTime end; // AddDateTime and SetLastEndTime
+};
+
+
+QDataStream &operator<<(QDataStream &out, const JournalEvent &event);
+QDataStream &operator>>(QDataStream &in, JournalEvent &event);
+
+#endif // JOURNALEVENT_HPP
@@ -12,53 +12,211 @@
 */
 
 #include "taskitem.hpp"
+#include <QtAlgorithms>
 
 
-TaskItem::TaskItem(const QString &name, bool done, TaskItem *parent)
-        : m_name(name), m_done(done), m_parent(parent)
+namespace {
+
+int minutesFor(qint64 start, qint64 end)
 {
-    if (m_parent)
-        m_parent->addChild(this);
+    return static_cast<int>((end - start) / (60 * 1000));
 }
 
 
-QString TaskItem::todaysTime() const
+bool rowLessThan(const TaskItem *a, const TaskItem *b)
+{
+    return a->parent()->rowOfChild(a) < b->parent()->rowOfChild(b);
+}
+
+
+bool startsBefore(const TaskItem::Interval &a,
+                  const TaskItem::Interval &b)
+{
+    return a.start < b.start;
+}
+
+
+QString hoursAndMinutes(int minutes)
 {
-    int minutes = minutesForTask(true);
     return QString("%1:%2").arg(minutes / 60)
                            .arg(minutes % 60, 2, 10, QChar('0'));
 }
 
+} // anonymous namespace
+
+
+TaskItem::TaskItem(const QString &name, bool done, TaskItem *parent)
+        : m_id(0), m_name(name), m_done(done), m_minutes(0),
+          m_totalMinutes(0), m_todaysMinutes(0), m_totalTodaysMinutes(0),
+          m_parent(0), m_row(-1)
+{
+    if (parent)
+        parent->addChild(this);
+}
+
+
+void TaskItem::setName(const QString &name)
+{
+    if (m_parent) {
+        m_parent->m_childrenByName.remove(m_name, this);
+        m_parent->m_childrenByName.insert(name, this);
+    }
+    m_name = name;
+}
+
+
+QString TaskItem::todaysTime() const
+{
+    return hoursAndMinutes(todaysMinutes());
+}
+
 
 QString TaskItem::totalTime() const
 {
-    int minutes = minutesForTask(false);
-    return QString("%1:%2").arg(minutes / 60)
-                           .arg(minutes % 60, 2, 10, QChar('0'));
+    return hoursAndMinutes(m_totalMinutes);
+}
+
+
+int TaskItem::todaysMinutes() const
+{
+    const QDate today = QDate::currentDate();
+    if (m_today != today) {
+        const TaskItem *root = this;
+        while (root->m_parent)
+            root = root->m_parent;
+        root->refreshToday(today);
+    }
+    return m_totalTodaysMinutes;
+}
+
+
+// Called for the whole tree when the date has changed, i.e., once a day
+void TaskItem::refreshToday(const QDate &today) const
+{
+    m_today = today;
+    m_todaysMinutes = minutesBetween(QDateTime(today),
+                                     QDateTime(today.addDays(1)));
+    m_totalTodaysMinutes = m_todaysMinutes;
+    foreach (TaskItem *child, m_children) {
+        if (child->m_today != today)
+            child->refreshToday(today);
+        m_totalTodaysMinutes += child->m_totalTodaysMinutes;
+    }
 }
 
 
-int TaskItem::minutesForTask(bool onlyForToday) const
+// Adds minutes that fall on the given date to this item's own totals
+// and to the subtree totals of it and all its ancestors
+void TaskItem::addMinutes(const QDate &date, int minutes)
 {
-    int minutes = 0;
-    QListIterator<QPair<QDateTime, QDateTime> > i(m_dateTimes);
-    while (i.hasNext()) {
-        const QPair<QDateTime, QDateTime> &dateTime = i.next();
-        if (onlyForToday &&
-            dateTime.first.date() != QDate::currentDate())
-            continue;
-        minutes += (dateTime.first.secsTo(dateTime.second) / 60);
+    if (!minutes)
+        return;
+    m_minutes += minutes;
+    if (m_today.isValid() && m_today == date)
+        m_todaysMinutes += minutes;
+    for (TaskItem *item = this; item; item = item->m_parent) {
+        item->m_totalMinutes += minutes;
+        if (item->m_today.isValid() && item->m_today == date)
+            item->m_totalTodaysMinutes += minutes;
     }
+}
+
+
+// Date/times are nearly always added in order so the new one usually
+// just goes at the end
+void TaskItem::addDateTime(const QDateTime &start, const QDateTime &end)
+{
+    Interval interval;
+    interval.start = start.toMSecsSinceEpoch();
+    interval.end = end.toMSecsSinceEpoch();
+    const int minutes = minutesFor(interval.start, interval.end);
+    const int i = qUpperBound(m_intervals.begin(), m_intervals.end(),
+                              interval, startsBefore) -
+                  m_intervals.begin();
+    m_intervals.insert(i, interval);
+    m_runningMinutes.insert(i, (i ? m_runningMinutes.at(i - 1) : 0) +
+                               minutes);
+    for (int j = i + 1; j < m_runningMinutes.count(); ++j)
+        m_runningMinutes[j] += minutes;
+    addMinutes(start.date(), minutes);
+}
+
+
+// Returns the minutes of this item's own date/times that start at or
+// after from and before to
+int TaskItem::minutesBetween(const QDateTime &from,
+                             const QDateTime &to) const
+{
+    Interval key;
+    key.start = from.toMSecsSinceEpoch();
+    QVector<Interval>::const_iterator begin = qLowerBound(
+            m_intervals.constBegin(), m_intervals.constEnd(), key,
+            startsBefore);
+    key.start = to.toMSecsSinceEpoch();
+    QVector<Interval>::const_iterator end = qLowerBound(begin,
+            m_intervals.constEnd(), key, startsBefore);
+    if (begin == end)
+        return 0;
+    const int first = begin - m_intervals.constBegin();
+    const int last = (end - m_intervals.constBegin()) - 1;
+    return m_runningMinutes.at(last) -
+           (first ? m_runningMinutes.at(first - 1) : 0);
+}
+
+
+// As minutesBetween() but for this item and all its descendants
+int TaskItem::totalMinutesBetween(const QDateTime &from,
+                                  const QDateTime &to) const
+{
+    int minutes = minutesBetween(from, to);
     foreach (TaskItem *child, m_children)
-        minutes += child->minutesForTask(onlyForToday);
+        minutes += child->totalMinutesBetween(from, to);
     return minutes;
 }
 
 
-void TaskItem::incrementLastEndTime(int msec)
+// Returns how many whole minutes the last date/time has grown by
+int TaskItem::incrementLastEndTime(int msec)
+{
+    return changeLastEnd(m_intervals.last().end + msec);
+}
+
+
+void TaskItem::setLastEndTime(const QDateTime &end)
 {
-    QDateTime &endTime = m_dateTimes.last().second;
-    endTime.setTime(endTime.time().addMSecs(msec));
+    changeLastEnd(end.toMSecsSinceEpoch());
+}
+
+
+int TaskItem::changeLastEnd(qint64 end)
+{
+    Interval &interval = m_intervals.last();
+    const int oldMinutes = minutesFor(interval.start, interval.end);
+    interval.end = end;
+    const int minutes = minutesFor(interval.start, interval.end) -
+                        oldMinutes;
+    m_runningMinutes.last() += minutes;
+    addMinutes(QDateTime::fromMSecsSinceEpoch(interval.start).date(),
+               minutes);
+    return minutes;
+}
+
+
+void TaskItem::insertChild(int row, TaskItem *item)
+{
+    Q_ASSERT(!item->m_parent);
+    if (m_today.isValid() && item->m_today != m_today)
+        item->refreshToday(m_today);
+    item->m_parent = this;
+    m_children.insert(row, item);
+    m_childrenByName.insert(item->m_name, item);
+    renumberChildrenFrom(row);
+    for (TaskItem *ancestor = this; ancestor;
+         ancestor = ancestor->m_parent) {
+        ancestor->m_totalMinutes += item->m_totalMinutes;
+        if (ancestor->m_today.isValid() && ancestor->m_today == m_today)
+            ancestor->m_totalTodaysMinutes += item->m_totalTodaysMinutes;
+    }
 }
 
 
@@ -66,6 +224,40 @@ TaskItem* TaskItem::takeChild(int row)
 {
     TaskItem *item = m_children.takeAt(row);
     Q_ASSERT(item);
+    m_childrenByName.remove(item->m_name, item);
+    renumberChildrenFrom(row);
+    for (TaskItem *ancestor = this; ancestor;
+         ancestor = ancestor->m_parent) {
+        ancestor->m_totalMinutes -= item->m_totalMinutes;
+        if (ancestor->m_today.isValid() && ancestor->m_today == m_today)
+            ancestor->m_totalTodaysMinutes -= item->m_totalTodaysMinutes;
+    }
     item->m_parent = 0;
+    item->m_row = -1;
     return item;
 }
+
+
+void TaskItem::swapChildren(int oldRow, int newRow)
+{
+    m_children.swap(oldRow, newRow);
+    m_children.at(oldRow)->m_row = oldRow;
+    m_children.at(newRow)->m_row = newRow;
+}
+
+
+void TaskItem::renumberChildrenFrom(int row)
+{
+    for (; row < m_children.count(); ++row)
+        m_children.at(row)->m_row = row;
+}
+
+
+// Returns the children with the given name in row order
+QList<TaskItem*> TaskItem::childrenNamed(const QString &name) const
+{
+    QList<TaskItem*> children = m_childrenByName.values(name);
+    if (children.count() > 1)
+        qSort(children.begin(), children.end(), rowLessThan);
+    return children;
+}
@@ -14,56 +14,103 @@
 */
 
 #include <QDateTime>
+#include <QHash>
 #include <QList>
-#include <QPair>
 #include <QString>
+#include <QVector>
 
 
     // QList::value() returns default constructed value for out of range
     // row
+
+// Each item caches the minutes of its own date/times and of its whole
+// subtree, both in total and for today. Any change to an item's times
+// or children is applied as a delta to it and each of its ancestors, so
+// reading a total never rescans history. The today totals of the whole
+// tree are recomputed the first time they're asked for after the date
+// changes, so every item in a tree has them for the same date.
+//
+// An item's date/times are held as pairs of milliseconds since the
+// epoch in one contiguous vector, kept sorted by start time, along with
+// a running total of their minutes. So the minutes for any range of
+// dates, e.g., for a week or a month, take two binary searches. The
+// "last" date/time is the one that started latest, which is always the
+// one being timed.
+//
+// Each item also knows its own row and keeps a hash of its children by
+// name, so rowOfChild() and finding a child by name don't need to
+// search; both are kept up to date by every function that changes the
+// children or an item's name.
 class TaskItem
 {
 public:
+    struct Interval
+    {
+        qint64 start;
+        qint64 end;
+    };
+
     explicit TaskItem(const QString &name=QString(), bool done=false,
                       TaskItem *parent=0);
     ~TaskItem() { qDeleteAll(m_children); }
 
+    quint32 id() const { return m_id; }
+    void setId(quint32 id) { m_id = id; }
     QString name() const { return m_name; }
-    void setName(const QString &name) { m_name = name; }
+    void setName(const QString &name);
     bool isDone() const { return m_done; }
     void setDone(bool done) { m_done = done; }
-    QList<QPair<QDateTime, QDateTime> > dateTimes() const
-        { return m_dateTimes; }
-    void addDateTime(const QDateTime &start, const QDateTime &end)
-        { m_dateTimes << qMakePair(start, end); }
+    int dateTimeCount() const { return m_intervals.count(); }
+    QDateTime startTime(int i) const
+        { return QDateTime::fromMSecsSinceEpoch(m_intervals.at(i).start); }
+    QDateTime endTime(int i) const
+        { return QDateTime::fromMSecsSinceEpoch(m_intervals.at(i).end); }
+    void addDateTime(const QDateTime &start, const QDateTime &end);
+    int minutesBetween(const QDateTime &from, const QDateTime &to) const;
+    int totalMinutesBetween(const QDateTime &from,
+                            const QDateTime &to) const;
     QString todaysTime() const;
     QString totalTime() const;
-    void incrementLastEndTime(int msec);
+    QDateTime lastEndTime() const
+        { return QDateTime::fromMSecsSinceEpoch(m_intervals.last().end); }
+    int incrementLastEndTime(int msec);
+    void setLastEndTime(const QDateTime &end);
     TaskItem *parent() const { return m_parent; }
     TaskItem *childAt(int row) const { return m_children.value(row); }
-    int rowOfChild(TaskItem *child) const
-        { return m_children.indexOf(child); }
+    int rowOfChild(const TaskItem *child) const
+        { return child && child->m_parent == this ? child->m_row : -1; }
+    QList<TaskItem*> childrenNamed(const QString &name) const;
     int childCount() const { return m_children.count(); }
     bool hasChildren() const { return !m_children.isEmpty(); }
     QList<TaskItem*> children() const { return m_children; }
 
-    void insertChild(int row, TaskItem *item)
-        { item->m_parent = this; m_children.insert(row, item); }
-    void addChild(TaskItem *item)
-        { item->m_parent = this; m_children << item; }
-    void swapChildren(int oldRow, int newRow)
-        { m_children.swap(oldRow, newRow); }
+    void insertChild(int row, TaskItem *item);
+    void addChild(TaskItem *item) { insertChild(m_children.count(), item); }
+    void swapChildren(int oldRow, int newRow);
     TaskItem* takeChild(int row);
 
 private:
-    int minutesForTask(bool onlyForToday) const;
+    int todaysMinutes() const;
+    void refreshToday(const QDate &today) const;
+    void addMinutes(const QDate &date, int minutes);
+    void renumberChildrenFrom(int row);
+    int changeLastEnd(qint64 end);
 
+    quint32 m_id; // 0 until the model gives the item a journal id
     QString m_name;
     bool m_done;
-    QList<QPair<QDateTime, QDateTime> > m_dateTimes;
+    QVector<Interval> m_intervals;
+    QVector<int> m_runningMinutes; // Minutes of intervals 0..i
+    int m_minutes;
+    int m_totalMinutes;
+    mutable QDate m_today;
+    mutable int m_todaysMinutes;
+    mutable int m_totalTodaysMinutes;
 
     TaskItem *m_parent;
+    int m_row;
     QList<TaskItem*> m_children;
+    QMultiHash<QString, TaskItem*> m_childrenByName;
 };
 
 #endif // TASKITEM_HPP
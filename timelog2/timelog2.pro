@@ -12,12 +12,16 @@ SOURCES	    += ../timelog1/richtextlineedit.cpp
 HEADERS	    += ../timelog1/richtextdelegate.hpp
 SOURCES	    += ../timelog1/richtextdelegate.cpp
 HEADERS	    += ../timelog1/global.hpp
+HEADERS	    += ../timelog1/hidedonetasks.hpp
+SOURCES	    += ../timelog1/hidedonetasks.cpp
 HEADERS	    += ../timelog1/mainwindow.hpp
 SOURCES     += ../timelog1/mainwindow.cpp
 SOURCES     += ../timelog1/main.cpp
 RESOURCES   += ../timelog1/timelog.qrc
 INCLUDEPATH += ../timelog1
 DEFINES	    += CUSTOM_MODEL
+HEADERS	    += journalevent.hpp
+SOURCES	    += journalevent.cpp
 HEADERS	    += taskitem.hpp
 SOURCES	    += taskitem.cpp
 HEADERS	    += treemodel.hpp
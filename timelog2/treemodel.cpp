@@ -14,8 +14,12 @@
 #include "aqp.hpp"
 #include "global.hpp"
 #include "treemodel.hpp"
+#include <QDataStream>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QMimeData>
+#include <QSaveFile>
 
 
 namespace {
@@ -23,8 +27,21 @@ const int ColumnCount = 3;
 const int MaxCompression = 9;
 enum Column {Name, Today, Total};
 const QString MimeType = "application/vnd.qtrac.xml.task.z";
+const qint32 MagicNumber = 0x544C6F67;
+const qint16 FormatNumber = 100;
+const int MinCompaction = 1000;
+const QString JournalSuffix(".tlj");
+
+
+void forgetIds(TaskItem *item, QHash<quint32, TaskItem*> *itemForId)
+{
+    itemForId->remove(item->id());
+    foreach (TaskItem *child, item->children())
+        forgetIds(child, itemForId);
 }
 
+} // anonymous namespace
+
 
 Qt::ItemFlags TreeModel::flags(const QModelIndex &index) const
 {
@@ -149,10 +166,14 @@ bool TreeModel::setData(const QModelIndex &index,
     if (!index.isValid() || index.column() != Name)
         return false;
     if (TaskItem *item = itemForIndex(index)) {
-        if (role == Qt::EditRole)
+        if (role == Qt::EditRole) {
             item->setName(value.toString());
-        else if (role == Qt::CheckStateRole)
+            journal(JournalEvent::RenameTask, item);
+        }
+        else if (role == Qt::CheckStateRole) {
             item->setDone(value.toBool());
+            journal(JournalEvent::SetTaskDone, item);
+        }
         else
             return false;
         emit dataChanged(index, index);
@@ -173,6 +194,8 @@ bool TreeModel::insertRows(int row, int count,
     for (int i = 0; i < count; ++i) {
         TaskItem *item = new TaskItem(tr("New Task"), false);
         parentItem->insertChild(row, item);
+        if (journaling())
+            journalSubtree(item, row, &m_pendingEvents);
     }
     endInsertRows();
     return true;
@@ -187,8 +210,11 @@ bool TreeModel::removeRows(int row, int count,
     TaskItem *item = parent.isValid() ? itemForIndex(parent)
                                       : rootItem;
     beginRemoveRows(parent, row, row + count - 1);
-    for (int i = 0; i < count; ++i)
-        delete item->takeChild(row);
+    for (int i = 0; i < count; ++i) {
+        TaskItem *child = item->takeChild(row);
+        journal(JournalEvent::RemoveTask, child);
+        delete child;
+    }
     endRemoveRows();
     return true;
 }
@@ -234,9 +260,16 @@ bool TreeModel::dropMimeData(const QMimeData *mimeData,
         if (row == -1)
             row = parent.isValid() ? parent.row()
                                    : rootItem->childCount();
+        int oldCount = item->childCount();
         beginInsertRows(parent, row, row);
         readTasks(&reader, item);
         endInsertRows();
+        if (journaling()) {
+            for (int newRow = oldCount; newRow < item->childCount();
+                 ++newRow)
+                journalSubtree(item->childAt(newRow), newRow,
+                               &m_pendingEvents);
+        }
         return true;
     }
     return false;
@@ -269,6 +302,8 @@ QModelIndex TreeModel::moveItem(TaskItem *parent, int oldRow,
     Q_ASSERT(0 <= oldRow && oldRow < parent->childCount() &&
              0 <= newRow && newRow < parent->childCount());
     parent->swapChildren(oldRow, newRow);
+    // The rows are always adjacent so one move does the swap
+    journalMove(parent->childAt(newRow), parent, newRow);
     QModelIndex oldIndex = createIndex(oldRow, 0,
                                        parent->childAt(oldRow));
     QModelIndex newIndex = createIndex(newRow, 0,
@@ -306,6 +341,7 @@ QModelIndex TreeModel::cut(const QModelIndex &index)
     beginRemoveRows(index.parent(), row, row);
     TaskItem *child = parent->takeChild(row);
     endRemoveRows();
+    journal(JournalEvent::RemoveTask, child);
     Q_ASSERT(child == cutItem);
     child = 0; // Silence compiler unused variable warning
 
@@ -336,6 +372,8 @@ QModelIndex TreeModel::paste(const QModelIndex &index)
     TaskItem *child = cutItem;
     cutItem = 0;
     endInsertRows();
+    if (journaling())
+        journalSubtree(child, row, &m_pendingEvents);
     return createIndex(row, 0, child);
 }
 
@@ -358,6 +396,7 @@ QModelIndex TreeModel::promote(const QModelIndex &index)
     Q_ASSERT(grandParent);
     row = grandParent->rowOfChild(parent) + 1;
     grandParent->insertChild(row, child);
+    journalMove(child, grandParent, row);
     QModelIndex newIndex = createIndex(row, 0, child);
     emit dataChanged(newIndex, newIndex);
     return newIndex;
@@ -380,6 +419,7 @@ QModelIndex TreeModel::demote(const QModelIndex &index)
     TaskItem *sibling = parent->childAt(row - 1);
     Q_ASSERT(sibling);
     sibling->addChild(child);
+    journalMove(child, sibling, sibling->childCount() - 1);
     QModelIndex newIndex = createIndex(sibling->childCount() - 1, 0,
                                        child);
     emit dataChanged(newIndex, newIndex);
@@ -429,30 +469,138 @@ void TreeModel::announceItemChanged(TaskItem *item)
 }
 
 
+// Only the Today and Total columns change when time is added, so just
+// those are announced, once for each level from the item up
+void TreeModel::announceTimesChanged(TaskItem *item)
+{
+    while (item != rootItem) {
+        TaskItem *parent = item->parent();
+        Q_ASSERT(parent);
+        int row = parent->rowOfChild(item);
+        emit dataChanged(createIndex(row, static_cast<int>(Today), item),
+                         createIndex(row, static_cast<int>(Total), item));
+        item = parent;
+    }
+}
+
+
 void TreeModel::addDateTimeToTimedItem(const QDateTime &start,
                                        const QDateTime &end)
 {
     if (timedItem) {
         timedItem->addDateTime(start, end);
+        if (journaling()) {
+            JournalEvent event(JournalEvent::AddDateTime,
+                               idFor(timedItem));
+            event.start = start;
+            event.end = end;
+            m_pendingEvents << event;
+        }
         announceItemChanged(timedItem);
     }
 }
 
 
+// The icon is only shown in the timed item's Today column
 void TreeModel::setIconForTimedItem(const QIcon &icon)
 {
     m_icon = icon;
-    if (timedItem)
-        announceItemChanged(timedItem);
+    if (timedItem && timedItem != rootItem) {
+        int row = timedItem->parent()->rowOfChild(timedItem);
+        QModelIndex index = createIndex(row, static_cast<int>(Today),
+                                        timedItem);
+        emit dataChanged(index, index);
+    }
 }
 
 
+// The timer ticks several times a second but the times are shown in
+// whole minutes, so most ticks change nothing that can be seen
 void TreeModel::incrementEndTimeForTimedItem(int msec)
 {
-    if (timedItem) {
-        timedItem->incrementLastEndTime(msec);
-        announceItemChanged(timedItem);
+    if (!timedItem)
+        return;
+    const int minutes = timedItem->incrementLastEndTime(msec);
+    if (journaling())
+        journalLastEndTime(timedItem);
+    if (minutes)
+        announceTimesChanged(timedItem);
+}
+
+
+// Ids are only handed out when an item is first journaled; the root is
+// always 0
+quint32 TreeModel::idFor(TaskItem *item)
+{
+    if (item == rootItem)
+        return 0;
+    if (!item->id())
+        item->setId(m_nextId++);
+    return item->id();
+}
+
+
+void TreeModel::journal(JournalEvent::Type type, TaskItem *item)
+{
+    if (!journaling())
+        return;
+    JournalEvent event(type, idFor(item));
+    if (type == JournalEvent::RenameTask)
+        event.name = item->name();
+    else if (type == JournalEvent::SetTaskDone)
+        event.done = item->isDone();
+    m_pendingEvents << event;
+}
+
+
+void TreeModel::journalMove(TaskItem *item, TaskItem *parent, int row)
+{
+    if (!journaling())
+        return;
+    JournalEvent event(JournalEvent::MoveTask, idFor(item));
+    event.parentId = idFor(parent);
+    event.row = row;
+    m_pendingEvents << event;
+}
+
+
+void TreeModel::journalSubtree(TaskItem *item, int row,
+                               QList<JournalEvent> *events)
+{
+    JournalEvent event(JournalEvent::AddTask, idFor(item));
+    event.parentId = idFor(item->parent());
+    event.row = row;
+    event.name = item->name();
+    event.done = item->isDone();
+    *events << event;
+    for (int i = 0; i < item->dateTimeCount(); ++i) {
+        JournalEvent whenEvent(JournalEvent::AddDateTime, event.id);
+        whenEvent.start = item->startTime(i);
+        whenEvent.end = item->endTime(i);
+        *events << whenEvent;
     }
+    for (int childRow = 0; childRow < item->childCount(); ++childRow)
+        journalSubtree(item->childAt(childRow), childRow, events);
+}
+
+
+// If the last pending event already set the item's last end time it is
+// simply updated, so however long a task is timed for, only one event
+// is saved for it
+void TreeModel::journalLastEndTime(TaskItem *item)
+{
+    const quint32 id = idFor(item);
+    if (!m_pendingEvents.isEmpty()) {
+        JournalEvent &last = m_pendingEvents.last();
+        if (last.id == id && (last.type == JournalEvent::AddDateTime ||
+                              last.type == JournalEvent::SetLastEndTime)) {
+            last.end = item->lastEndTime();
+            return;
+        }
+    }
+    JournalEvent event(JournalEvent::SetLastEndTime, id);
+    event.end = item->lastEndTime();
+    m_pendingEvents << event;
 }
 
 
@@ -463,6 +611,10 @@ void TreeModel::clear()
     delete cutItem;
     cutItem = 0;
     timedItem = 0;
+    m_journalFilename.clear();
+    m_nextId = 1;
+    m_snapshotEvents = m_appendedEvents = 0;
+    m_pendingEvents.clear();
     //reset();         //deleted for Qt5
     beginResetModel(); //added for Qt5
     endResetModel();   //added for Qt5
@@ -481,16 +633,119 @@ void TreeModel::load(const QString &filename)
 
     clear();
     rootItem = new TaskItem;
-    QXmlStreamReader reader(&file);
-    readTasks(&reader, rootItem);
-    if (reader.hasError())
-        throw AQP::Error(reader.errorString());
+    QDataStream in(&file);
+    qint32 magicNumber;
+    in >> magicNumber;
+    if (in.status() == QDataStream::Ok && magicNumber == MagicNumber)
+        readJournal(&in);
+    else { // Import an XML file
+        file.seek(0);
+        QXmlStreamReader reader(&file);
+        readTasks(&reader, rootItem);
+        if (reader.hasError())
+            throw AQP::Error(reader.errorString());
+    }
     //reset();         //deleted for Qt5
     beginResetModel(); //added for Qt5
     endResetModel();   //added for Qt5
 }
 
 
+// Replays the snapshot and then every event appended after it. If the
+// last append was cut short the events it did write are kept, and the
+// next save writes a fresh snapshot rather than appending after them.
+void TreeModel::readJournal(QDataStream *in)
+{
+    qint16 formatVersionNumber;
+    *in >> formatVersionNumber;
+    if (formatVersionNumber > FormatNumber)
+        throw AQP::Error(tr("file format version is too new"));
+    in->setVersion(QDataStream::Qt_4_5);
+    qint32 snapshotEvents;
+    *in >> snapshotEvents;
+    if (in->status() != QDataStream::Ok || snapshotEvents < 0)
+        throw AQP::Error(tr("corrupt file"));
+
+    QHash<quint32, TaskItem*> itemForId;
+    itemForId.insert(0, rootItem);
+    quint32 maxId = 0;
+    int events = 0;
+    while (!in->atEnd()) {
+        JournalEvent event;
+        *in >> event;
+        if (in->status() != QDataStream::Ok)
+            break;
+        applyEvent(event, &itemForId);
+        maxId = qMax(maxId, event.id);
+        ++events;
+    }
+    if (events < snapshotEvents)
+        throw AQP::Error(tr("corrupt file"));
+    m_nextId = maxId + 1;
+    m_snapshotEvents = snapshotEvents;
+    m_appendedEvents = events - snapshotEvents;
+    if (in->status() == QDataStream::Ok)
+        m_journalFilename = m_filename;
+}
+
+
+void TreeModel::applyEvent(const JournalEvent &event,
+                           QHash<quint32, TaskItem*> *itemForId)
+{
+    if (event.type == JournalEvent::AddTask) {
+        TaskItem *parent = itemForId->value(event.parentId);
+        if (!event.id || itemForId->contains(event.id) || !parent ||
+            event.row < 0 || event.row > parent->childCount())
+            throw AQP::Error(tr("corrupt file"));
+        TaskItem *item = new TaskItem(event.name, event.done);
+        item->setId(event.id);
+        parent->insertChild(event.row, item);
+        itemForId->insert(event.id, item);
+        return;
+    }
+    TaskItem *item = event.id ? itemForId->value(event.id) : 0;
+    if (!item)
+        throw AQP::Error(tr("corrupt file"));
+    TaskItem *parent = item->parent();
+    Q_ASSERT(parent);
+    switch (event.type) {
+        case JournalEvent::RemoveTask:
+            forgetIds(item, itemForId);
+            delete parent->takeChild(parent->rowOfChild(item));
+            break;
+        case JournalEvent::MoveTask: {
+            TaskItem *newParent = itemForId->value(event.parentId);
+            for (TaskItem *ancestor = newParent; ancestor;
+                 ancestor = ancestor->parent()) {
+                if (ancestor == item) {
+                    newParent = 0; // Can't move an item into itself
+                    break;
+                }
+            }
+            int maxRow = newParent ? newParent->childCount() : -1;
+            if (newParent == parent)
+                --maxRow;
+            if (event.row < 0 || event.row > maxRow)
+                throw AQP::Error(tr("corrupt file"));
+            parent->takeChild(parent->rowOfChild(item));
+            newParent->insertChild(event.row, item);
+            break;
+        }
+        case JournalEvent::RenameTask: item->setName(event.name); break;
+        case JournalEvent::SetTaskDone: item->setDone(event.done); break;
+        case JournalEvent::AddDateTime:
+            item->addDateTime(event.start, event.end);
+            break;
+        case JournalEvent::SetLastEndTime:
+            if (!item->dateTimeCount())
+                throw AQP::Error(tr("corrupt file"));
+            item->setLastEndTime(event.end);
+            break;
+        default: throw AQP::Error(tr("corrupt file"));
+    }
+}
+
+
 void TreeModel::readTasks(QXmlStreamReader *reader, TaskItem *task)
 {
     while (!reader->atEnd()) {
@@ -531,7 +786,80 @@ void TreeModel::save(const QString &filename)
         m_filename = filename;
     if (m_filename.isEmpty())
         throw AQP::Error(tr("no filename specified"));
+    if (!m_filename.endsWith(JournalSuffix, Qt::CaseInsensitive)) {
+        const QFileInfo info(m_filename);
+        m_filename = info.dir().filePath(info.completeBaseName() +
+                                         JournalSuffix);
+    }
+    if (m_journalFilename != m_filename ||
+        m_appendedEvents + m_pendingEvents.count() >
+                qMax(MinCompaction, m_snapshotEvents))
+        writeSnapshot();
+    else
+        appendPendingEvents();
+}
+
+
+// The snapshot is written to a temporary file that atomically replaces
+// the old one when committed, so the old journal survives if writing
+// fails or the program dies part way through
+void TreeModel::writeSnapshot()
+{
+    QList<JournalEvent> events;
+    if (rootItem) {
+        for (int row = 0; row < rootItem->childCount(); ++row)
+            journalSubtree(rootItem->childAt(row), row, &events);
+    }
+    QSaveFile file(m_filename);
+    if (!file.open(QIODevice::WriteOnly))
+        throw AQP::Error(file.errorString());
+    QDataStream out(&file);
+    out << MagicNumber << FormatNumber;
+    out.setVersion(QDataStream::Qt_4_5);
+    out << static_cast<qint32>(events.count());
+    foreach (const JournalEvent &event, events)
+        out << event;
+    if (out.status() != QDataStream::Ok) // The temporary is discarded
+        throw AQP::Error(tr("failed to write %1").arg(m_filename));
+    if (!file.commit())
+        throw AQP::Error(tr("failed to replace %1: %2").arg(m_filename)
+                         .arg(file.errorString()));
+    m_journalFilename = m_filename;
+    m_snapshotEvents = events.count();
+    m_appendedEvents = 0;
+    m_pendingEvents.clear();
+}
+
+
+void TreeModel::appendPendingEvents()
+{
+    if (m_pendingEvents.isEmpty())
+        return;
     QFile file(m_filename);
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Append))
+        throw AQP::Error(file.errorString());
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    foreach (const JournalEvent &event, m_pendingEvents)
+        out << event;
+    file.close();
+    if (out.status() != QDataStream::Ok ||
+        file.error() != QFile::NoError) {
+        // Whatever did get appended is discarded by the next snapshot
+        m_journalFilename.clear();
+        m_pendingEvents.clear();
+        throw AQP::Error(tr("failed to write %1").arg(m_filename));
+    }
+    m_appendedEvents += m_pendingEvents.count();
+    m_pendingEvents.clear();
+}
+
+
+void TreeModel::exportXml(const QString &filename)
+{
+    if (filename.isEmpty())
+        throw AQP::Error(tr("no filename specified"));
+    QFile file(filename);
     if (!file.open(QIODevice::WriteOnly|QIODevice::Text))
         throw AQP::Error(file.errorString());
 
@@ -554,15 +882,12 @@ void TreeModel::writeTaskAndChildren(QXmlStreamWriter *writer,
         writer->writeAttribute(NameAttribute, task->name());
         writer->writeAttribute(DoneAttribute, task->isDone() ? "1"
                                                              : "0");
-        QListIterator<
-                QPair<QDateTime, QDateTime> > i(task->dateTimes());
-        while (i.hasNext()) {
-            const QPair<QDateTime, QDateTime> &dateTime = i.next();
+        for (int i = 0; i < task->dateTimeCount(); ++i) {
             writer->writeStartElement(WhenTag);
             writer->writeAttribute(StartAttribute,
-                    dateTime.first.toString(Qt::ISODate));
+                    task->startTime(i).toString(Qt::ISODate));
             writer->writeAttribute(EndAttribute,
-                    dateTime.second.toString(Qt::ISODate));
+                    task->endTime(i).toString(Qt::ISODate));
             writer->writeEndElement(); // WHEN
         }
     }
@@ -587,24 +912,25 @@ QStringList TreeModel::pathForIndex(const QModelIndex &index) const
 
 QModelIndex TreeModel::indexForPath(const QStringList &path) const
 {
-    return indexForPath(QModelIndex(), path);
+    if (!rootItem)
+        return QModelIndex();
+    return indexForPath(rootItem, path);
 }
 
 
-QModelIndex TreeModel::indexForPath(const QModelIndex &parent,
+// Only the children with the right name are looked at, so unless there
+// are sibling tasks with the same name this is O(depth)
+QModelIndex TreeModel::indexForPath(TaskItem *parent,
                                     const QStringList &path) const
 {
     if (path.isEmpty())
         return QModelIndex();
-    for (int row = 0; row < rowCount(parent); ++row) {
-        QModelIndex thisIndex = index(row, 0, parent);
-        if (data(thisIndex).toString() == path.at(0)) {
-            if (path.count() == 1)
-                return thisIndex;
-            thisIndex = indexForPath(thisIndex, path.mid(1));
-            if (thisIndex.isValid())
-                return thisIndex;
-        }
+    foreach (TaskItem *item, parent->childrenNamed(path.at(0))) {
+        if (path.count() == 1)
+            return createIndex(parent->rowOfChild(item), 0, item);
+        QModelIndex index = indexForPath(item, path.mid(1));
+        if (index.isValid())
+            return index;
     }
     return QModelIndex();
 }
@@ -13,17 +13,32 @@
     the GNU General Public License for more details.
 */
 
+#include "journalevent.hpp"
 #include "taskitem.hpp"
 #include <QAbstractItemModel>
+#include <QHash>
 #include <QIcon>
 // Mac needs these included this way---and needs them in the header
 #include <QtCore/QXmlStreamReader>
 #include <QtCore/QXmlStreamWriter>
 
 
+class QDataStream;
 class QMimeData;
 
 
+// Files are saved as journals: a snapshot of the whole tree as a list
+// of AddTask and AddDateTime events, followed by the events for each
+// change that has been saved since. So saving usually just appends the
+// changes made since the last save, however big the tree is; once more
+// events have been appended than the snapshot holds, the next save
+// writes a new snapshot instead. The timer's ticks only ever extend
+// the timed task's last date/time, so consecutive ticks are coalesced
+// into a single event. Files in the original XML format are imported
+// by load() and can still be written using exportXml(). Journals are
+// always saved with a .tlj suffix, so saving an imported .tlg writes a
+// new journal beside it and leaves the XML file for timelog1 to read.
+
 class TreeModel : public QAbstractItemModel
 {
     Q_OBJECT
@@ -31,7 +46,8 @@ class TreeModel : public QAbstractItemModel
 public:
     explicit TreeModel(QObject *parent=0)
         : QAbstractItemModel(parent), timedItem(0), rootItem(0),
-          cutItem(0) {}
+          cutItem(0), m_nextId(1), m_snapshotEvents(0),
+          m_appendedEvents(0) {}
     ~TreeModel() { delete rootItem; delete cutItem; }
 
     Qt::ItemFlags flags(const QModelIndex &index) const;
@@ -88,6 +104,7 @@ public:
         { m_filename = filename; }
     void load(const QString &filename=QString());
     void save(const QString &filename=QString());
+    void exportXml(const QString &filename);
     QStringList pathForIndex(const QModelIndex &index) const;
     QModelIndex indexForPath(const QStringList &path) const;
 
@@ -100,14 +117,32 @@ private:
     void writeTaskAndChildren(QXmlStreamWriter *writer,
                               TaskItem *task) const;
     void announceItemChanged(TaskItem *item);
-    QModelIndex indexForPath(const QModelIndex &parent,
+    void announceTimesChanged(TaskItem *item);
+    QModelIndex indexForPath(TaskItem *parent,
                              const QStringList &path) const;
     QModelIndex moveItem(TaskItem *parent, int oldRow, int newRow);
+    bool journaling() const { return !m_journalFilename.isEmpty(); }
+    quint32 idFor(TaskItem *item);
+    void journal(JournalEvent::Type type, TaskItem *item);
+    void journalMove(TaskItem *item, TaskItem *parent, int row);
+    void journalSubtree(TaskItem *item, int row,
+                        QList<JournalEvent> *events);
+    void journalLastEndTime(TaskItem *item);
+    void readJournal(QDataStream *in);
+    void applyEvent(const JournalEvent &event,
+                    QHash<quint32, TaskItem*> *itemForId);
+    void writeSnapshot();
+    void appendPendingEvents();
 
     QString m_filename;
     QIcon m_icon;
     TaskItem *timedItem;
     TaskItem *rootItem;
     TaskItem *cutItem;
+    QString m_journalFilename; // Empty until saved or loaded as one
+    quint32 m_nextId;
+    int m_snapshotEvents;
+    int m_appendedEvents;
+    QList<JournalEvent> m_pendingEvents;
 };
 #endif // TREEMODEL_HPP
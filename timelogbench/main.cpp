@@ -0,0 +1,199 @@
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include "hidedonetasks.hpp"
+#include "option_parser.hpp"
+#include "treemodel.hpp"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QQueue>
+#include <QTextStream>
+#include <QTreeView>
+
+
+namespace {
+
+// What MainWindow::hideOrShowDoneTask() used to do, kept to compare
+// against: recurse over the tree calling setRowHidden() for every row
+void hideOrShowDoneTaskRecursively(QTreeView *treeView, bool hide,
+                                   const QModelIndex &index)
+{
+    QAbstractItemModel *model = treeView->model();
+    bool hideThisOne = hide &&
+            index.data(Qt::CheckStateRole).toInt() == Qt::Checked;
+    if (index.isValid())
+        treeView->setRowHidden(index.row(), index.parent(),
+                               hideThisOne);
+    if (!hideThisOne) {
+        for (int row = 0; row < model->rowCount(index); ++row)
+            hideOrShowDoneTaskRecursively(treeView, hide,
+                                          model->index(row, 0, index));
+    }
+}
+
+
+// Breadth first, so the tree is as wide as it is deep
+int populate(TreeModel *model, int tasks, int branching, int donePercent)
+{
+    int done = 0;
+    int count = 0;
+    QQueue<QModelIndex> parents;
+    parents.enqueue(QModelIndex());
+    while (count < tasks && !parents.isEmpty()) {
+        const QModelIndex parent = parents.dequeue();
+        const int rows = qMin(branching, tasks - count);
+        model->insertRows(0, rows, parent);
+        for (int row = 0; row < rows; ++row) {
+            const QModelIndex index = model->index(row, 0, parent);
+            model->setData(index, QString("Task %1").arg(++count));
+            if (qrand() % 100 < donePercent) {
+                model->setData(index, Qt::Checked, Qt::CheckStateRole);
+                ++done;
+            }
+            parents.enqueue(index);
+        }
+    }
+    return done;
+}
+
+
+// Returns the number of hidden rows and a checksum of which they are
+void hiddenRows(QTreeView *treeView, int *count, quint64 *hash)
+{
+    QAbstractItemModel *model = treeView->model();
+    *count = 0;
+    *hash = Q_UINT64_C(14695981039346656037);
+    QQueue<QModelIndex> parents;
+    parents.enqueue(QModelIndex());
+    quint64 position = 0;
+    while (!parents.isEmpty()) {
+        const QModelIndex parent = parents.dequeue();
+        for (int row = 0; row < model->rowCount(parent); ++row) {
+            ++position;
+            if (treeView->isRowHidden(row, parent)) {
+                ++*count;
+                *hash ^= position;
+                *hash *= Q_UINT64_C(1099511628211);
+            }
+            parents.enqueue(model->index(row, 0, parent));
+        }
+    }
+}
+
+
+// Includes the delayed relayout the view does afterwards
+qint64 timeMSec(QTreeView *treeView, bool batched, bool hide)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (batched)
+        hideOrShowDoneTasks(treeView, hide);
+    else
+        hideOrShowDoneTaskRecursively(treeView, hide, QModelIndex());
+    QApplication::processEvents();
+    return timer.elapsed();
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    QTextStream out(stdout);
+    AQP::OptionParser parser(app.arguments(),
+            "usage: {program} [options]\n"
+            "\nGenerates a timelog tree and reports how long it takes to "
+            "hide and show its\ndone tasks, the old recursive way and "
+            "the batched way.\nWithout a display use -platform "
+            "offscreen.\n",
+            "\nCopyright (c) 2009-10 Qtrac Ltd. All rights reserved.");
+    AQP::IntegerOptionPtr tasksOpt = parser.addIntegerOption("t",
+                                                             "tasks");
+    tasksOpt->setHelp("number of tasks");
+    tasksOpt->setDefaultValue(100000);
+    tasksOpt->setMinimum(1);
+    AQP::IntegerOptionPtr branchingOpt = parser.addIntegerOption("b",
+            "branching");
+    branchingOpt->setHelp("subtasks per task");
+    branchingOpt->setDefaultValue(10);
+    branchingOpt->setMinimum(1);
+    AQP::IntegerOptionPtr doneOpt = parser.addIntegerOption("d", "done");
+    doneOpt->setHelp("percentage of tasks that are done");
+    doneOpt->setDefaultValue(20);
+    doneOpt->setMinimum(0);
+    doneOpt->setMaximum(100);
+    AQP::IntegerOptionPtr seedOpt = parser.addIntegerOption("s",
+                                                            "seed");
+    seedOpt->setHelp("random number seed");
+    seedOpt->setDefaultValue(1);
+    AQP::IntegerOptionPtr repeatsOpt = parser.addIntegerOption("r",
+            "repeats");
+    repeatsOpt->setHelp("times to run each (the fastest is reported)");
+    repeatsOpt->setDefaultValue(3);
+    repeatsOpt->setMinimum(1);
+    AQP::BooleanOptionPtr collapsedOpt = parser.addBooleanOption("c",
+            "collapsed");
+    collapsedOpt->setHelp("don't expand the tree");
+    if (!parser.parse())
+        return 2;
+
+    qsrand(static_cast<uint>(seedOpt->value()));
+    TreeModel model;
+    QElapsedTimer timer;
+    timer.start();
+    const int done = populate(&model, tasksOpt->value(),
+            branchingOpt->value(), doneOpt->value());
+    out << "tasks: " << tasksOpt->value() << " (" << done << " done), "
+        << "generated in " << timer.elapsed() << " ms\n";
+
+    QTreeView treeView;
+    treeView.setUniformRowHeights(true);
+    treeView.setModel(&model);
+    treeView.resize(800, 600);
+    treeView.show();
+    if (!collapsedOpt->value())
+        treeView.expandAll();
+    QApplication::processEvents();
+
+    int recursiveCount = 0;
+    int batchedCount = 0;
+    quint64 recursiveHash = 0;
+    quint64 batchedHash = 0;
+    qint64 best[2][2] = {{-1, -1}, {-1, -1}};
+    for (int i = 0; i < repeatsOpt->value(); ++i) {
+        for (int batched = 0; batched < 2; ++batched) {
+            for (int hide = 1; hide >= 0; --hide) {
+                const qint64 msec = timeMSec(&treeView, batched, hide);
+                if (best[batched][hide] < 0 || msec < best[batched][hide])
+                    best[batched][hide] = msec;
+                if (hide && batched)
+                    hiddenRows(&treeView, &batchedCount, &batchedHash);
+                else if (hide)
+                    hiddenRows(&treeView, &recursiveCount,
+                               &recursiveHash);
+            }
+        }
+    }
+    out << "recursive: hide " << best[0][1] << " ms, show " << best[0][0]
+        << " ms\n";
+    out << "batched:   hide " << best[1][1] << " ms, show " << best[1][0]
+        << " ms\n";
+    out << "hidden rows: " << batchedCount << "\n";
+    if (recursiveCount != batchedCount || recursiveHash != batchedHash) {
+        out << "mismatch: the recursive way hid " << recursiveCount
+            << " rows\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,21 @@
+CONFIG	    += console release
+CONFIG	    -= app_bundle
+HEADERS	    += ../aqp/aqp.hpp
+SOURCES	    += ../aqp/aqp.cpp
+INCLUDEPATH += ../aqp
+HEADERS	    += ../option_parser/option_parser.hpp
+SOURCES	    += ../option_parser/option_parser.cpp
+INCLUDEPATH += ../option_parser
+HEADERS	    += ../timelog1/global.hpp
+HEADERS	    += ../timelog1/hidedonetasks.hpp
+SOURCES	    += ../timelog1/hidedonetasks.cpp
+INCLUDEPATH += ../timelog1
+HEADERS	    += ../timelog2/journalevent.hpp
+SOURCES	    += ../timelog2/journalevent.cpp
+HEADERS	    += ../timelog2/taskitem.hpp
+SOURCES	    += ../timelog2/taskitem.cpp
+HEADERS	    += ../timelog2/treemodel.hpp
+SOURCES	    += ../timelog2/treemodel.cpp
+INCLUDEPATH += ../timelog2
+SOURCES	    += main.cpp
+QT += widgets
@@ -35,6 +35,7 @@
 #include <QGroupBox>
 #include <QHBoxLayout>
 #include <QHeaderView>
+#include <QItemSelection>
 #include <QLabel>
 #include <QPushButton>
 #include <QRadioButton>
@@ -42,6 +43,7 @@
 #include <QStatusBar>
 #include <QTableView>
 #include <QVBoxLayout>
+#include <QVector>
 
 
 const int StatusTimeout = AQP::MSecPerSecond * 10;
@@ -127,6 +129,10 @@ void MainWindow::createWidgets()
     tableView->setItemDelegate(new ItemDelegate(this));
     tableView->verticalHeader()->setDefaultAlignment(
             Qt::AlignVCenter|Qt::AlignRight);
+    // All rows are the same height, so they are never measured one by
+    // one; see loaded()
+    tableView->verticalHeader()->setSectionResizeMode(
+            QHeaderView::Fixed);
 }
 
 
@@ -143,7 +149,6 @@ void MainWindow::createComboBoxModel(QComboBox *comboBox, int column)
     UniqueProxyModel *uniqueProxyModel = new UniqueProxyModel(column,
                                                               this);
     uniqueProxyModel->setSourceModel(model);
-    uniqueProxyModel->sort(column, Qt::AscendingOrder);
     comboBox->setModel(uniqueProxyModel);
     comboBox->setModelColumn(column);
 }
@@ -198,6 +203,11 @@ void MainWindow::createConnections()
 #else
     connect(model, SIGNAL(itemChanged(QStandardItem*)),
             this, SLOT(setDirty()));
+    connect(model, SIGNAL(loadProgress(int, int)),
+            this, SLOT(reportLoadProgress(int, int)));
+    connect(model, SIGNAL(loaded()), this, SLOT(loaded()));
+    connect(model, SIGNAL(loadFailed(const QString&)),
+            this, SLOT(loadFailed(const QString&)));
 #endif
     connect(model, SIGNAL(rowsRemoved(const QModelIndex&,int,int)),
             this, SLOT(setDirty()));
@@ -292,32 +302,69 @@ void MainWindow::enableButtons(bool enable)
 }
 
 
+// Filtering and selecting are held off until loaded() or loadFailed(),
+// which for the custom model are called before this returns, so they
+// are always done against the complete data
 void MainWindow::load(const QString &filename)
 {
     QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
     loading = true;
     try {
         model->load(filename);
-        tableView->resizeColumnsToContents();
-        QHeaderView *header = tableView->horizontalHeader();
-        header->setSortIndicatorShown(true);
-        header->setSortIndicator(0, Qt::AscendingOrder);
-        createComboBoxModels();
-        setWindowModified(false);
+#ifdef CUSTOM_MODEL
+        loaded();
+#else
+        // The rows are read in the background and arrive in chunks;
+        // the buttons stay disabled until loaded() or loadFailed()
         setWindowTitle(tr("%1 - %2[*]")
                 .arg(QApplication::applicationName())
                 .arg(QFileInfo(filename).fileName()));
-        statusBar()->showMessage(tr("Loaded %n zipcode(s) from %1",
-                "", model->rowCount()).arg(filename), StatusTimeout);
+        statusBar()->showMessage(tr("Loading %1...").arg(filename));
+#endif
     } catch (AQP::Error &error) {
-        AQP::warning(this, tr("Error"), tr("Failed to load %1: %2")
-                .arg(filename).arg(QString::fromUtf8(error.what())));
+        loadFailed(QString::fromUtf8(error.what()));
     }
-    loading = false;
     tableView->setFocus();
+    QApplication::restoreOverrideCursor();
+}
+
+
+void MainWindow::loaded()
+{
+    if (proxyModel->rowCount())
+        tableView->verticalHeader()->setDefaultSectionSize(
+                tableView->sizeHintForRow(0));
+    tableView->resizeColumnsToContents();
+    QHeaderView *header = tableView->horizontalHeader();
+    header->setSortIndicatorShown(true);
+    header->setSortIndicator(0, Qt::AscendingOrder);
+    setWindowModified(false);
+    setWindowTitle(tr("%1 - %2[*]")
+            .arg(QApplication::applicationName())
+            .arg(QFileInfo(model->filename()).fileName()));
+    statusBar()->showMessage(tr("Loaded %n zipcode(s) from %1",
+            "", model->rowCount()).arg(model->filename()),
+            StatusTimeout);
+    loading = false;
+    enableButtons();
     radioButtonClicked();
+}
+
+
+void MainWindow::loadFailed(const QString &message)
+{
+    AQP::warning(this, tr("Error"), tr("Failed to load %1: %2")
+            .arg(model->filename()).arg(message));
+    loading = false;
     enableButtons();
-    QApplication::restoreOverrideCursor();
+    radioButtonClicked();
+}
+
+
+void MainWindow::reportLoadProgress(int done, int total)
+{
+    statusBar()->showMessage(tr("Loaded %L1 of %Ln zipcode(s)...", "",
+                                total).arg(done));
 }
 
 
@@ -389,7 +436,6 @@ void MainWindow::deleteZipcode()
 
     model->removeRow(index.row(), index.parent());
 
-    createComboBoxModels();
     if (!county.isEmpty())
         countyComboBox->setCurrentIndex(
                 countyComboBox->findText(county));
@@ -424,44 +470,37 @@ void MainWindow::performSelection()
     QString state = stateGroupBox->isChecked()
             ? stateComboBox->currentText() : QString();
 
+    // The matching rows come from the proxy model's indexes; once in
+    // proxy (i.e., view) order each run of consecutive rows is selected
+    // as a single range
+    QVector<int> rows;
+    foreach (const int sourceRow, proxyModel->sourceRowsMatching(
+                minimumZipcode, maximumZipcode, county, state))
+        rows << proxyModel->mapFromSource(
+                model->index(sourceRow, Zipcode)).row();
+    qSort(rows);
     QItemSelection selection;
-    int firstSelectedRow = -1;
-    for (int row = 0; row < proxyModel->rowCount(); ++row) {
-        QModelIndex index = proxyModel->index(row, Zipcode);
-        int zipcode = proxyModel->data(index).toInt();
-        if (zipcode < minimumZipcode || zipcode > maximumZipcode)
-            continue;
-        if (!matchingColumn(county, row, County))
-            continue;
-        if (!matchingColumn(state, row, State))
-            continue;
-        if (firstSelectedRow == -1)
-            firstSelectedRow = row;
-        QItemSelection rowSelection(index, index);
-        selection.merge(rowSelection, QItemSelectionModel::Select);
+    for (int i = 0; i < rows.count(); ) {
+        int j = i + 1;
+        while (j < rows.count() && rows.at(j) == rows.at(j - 1) + 1)
+            ++j;
+        selection.append(QItemSelectionRange(
+                proxyModel->index(rows.at(i), Zipcode),
+                proxyModel->index(rows.at(j - 1), Zipcode)));
+        i = j;
     }
     QItemSelectionModel *selectionModel = tableView->selectionModel();
     selectionModel->clearSelection();
     selectionModel->select(selection, QItemSelectionModel::Rows|
                                       QItemSelectionModel::Select);
-    if (firstSelectedRow != -1)
-        tableView->scrollTo(proxyModel->index(firstSelectedRow, 0));
+    if (!rows.isEmpty())
+        tableView->scrollTo(proxyModel->index(rows.first(), 0));
     statusBar()->showMessage(tr("Selected %L1 out of %Ln zipcode(s)",
-            "", model->rowCount()).arg(selection.count()),
+            "", model->rowCount()).arg(rows.count()),
             StatusTimeout);
 }
 
 
-bool MainWindow::matchingColumn(const QString &value, int row,
-                                int column)
-{
-    if (value.isEmpty())
-        return true;
-    QModelIndex index = proxyModel->index(row, column);
-    return value == proxyModel->data(index).toString();
-}
-
-
 void MainWindow::restoreFilters()
 {
     proxyModel->setMinimumZipcode(minimumZipSpinBox->value());
@@ -45,6 +45,9 @@ protected:
 private slots:
     void load();
     void load(const QString &filename);
+    void loaded();
+    void loadFailed(const QString &message);
+    void reportLoadProgress(int done, int total);
     bool save();
     void addZipcode();
     void deleteZipcode();
@@ -61,7 +64,6 @@ private:
     void createConnections();
     bool okToClearData();
     void enableButtons(bool enable=true);
-    bool matchingColumn(const QString &value, int row, int column);
     void restoreFilters();
     void reportFilterEffect();
     void performSelection();
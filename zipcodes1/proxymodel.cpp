@@ -13,59 +13,470 @@
 
 #include "global.hpp"
 #include "proxymodel.hpp"
+#include <QMap>
+#include <QSet>
+#include <QtAlgorithms>
+
+
+namespace {
+const int NoFilter = -1;
+const int NoMatch = -2;
+const int Unindexed = -1;
+
+
+class ZipcodeLessThan
+{
+public:
+    explicit ZipcodeLessThan(const QVector<int> &zipcodeForRow)
+        : zipcodeForRow(zipcodeForRow) {}
+
+    bool operator()(int a, int b) const
+    {
+        const int zipcodeA = zipcodeForRow.at(a);
+        const int zipcodeB = zipcodeForRow.at(b);
+        return zipcodeA < zipcodeB || (zipcodeA == zipcodeB && a < b);
+    }
+
+private:
+    const QVector<int> &zipcodeForRow;
+};
+
+
+// Returns the position of the first row in rowsByZipcode whose zipcode
+// is not less than the given zipcode
+int lowerBound(const QVector<int> &rowsByZipcode,
+               const QVector<int> &zipcodeForRow, int zipcode)
+{
+    int first = 0;
+    int count = rowsByZipcode.count();
+    while (count > 0) {
+        const int step = count / 2;
+        if (zipcodeForRow.at(rowsByZipcode.at(first + step)) < zipcode) {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+    return first;
+}
+
+
+int idFor(QHash<QString, int> *ids, QVector<QVector<int> > *rowsForId,
+          const QString &text)
+{
+    QHash<QString, int>::const_iterator i = ids->constFind(text);
+    if (i != ids->constEnd())
+        return i.value();
+    const int id = rowsForId->count();
+    ids->insert(text, id);
+    rowsForId->append(QVector<int>());
+    return id;
+}
+
+
+// Renumbers the rows at or after first to make room for count new rows
+void shiftRows(QVector<int> *rows, int first, int count)
+{
+    for (int i = 0; i < rows->count(); ++i)
+        if (rows->at(i) >= first)
+            (*rows)[i] += count;
+}
+
+
+// Drops the rows from first to last and renumbers the ones after them
+void removeRows(QVector<int> *rows, int first, int last)
+{
+    const int count = last - first + 1;
+    int j = 0;
+    for (int i = 0; i < rows->count(); ++i) {
+        const int row = rows->at(i);
+        if (row < first)
+            (*rows)[j++] = row;
+        else if (row > last)
+            (*rows)[j++] = row - count;
+    }
+    rows->resize(j);
+}
+
+
+// The rows are in ascending order so those from first to last are
+// contiguous
+void removeRange(QVector<int> *rows, int first, int last)
+{
+    QVector<int>::iterator begin = qLowerBound(rows->begin(),
+                                               rows->end(), first);
+    rows->erase(begin, qUpperBound(begin, rows->end(), last));
+}
+
+
+// The block is in ascending order and none of the rows already held
+// fall within it, so it goes in as one piece
+void insertRange(QVector<int> *rows, const QVector<int> &block)
+{
+    const int i = qLowerBound(rows->begin(), rows->end(), block.first())
+                  - rows->begin();
+    rows->insert(i, block.count(), 0);
+    qCopy(block.constBegin(), block.constEnd(), rows->begin() + i);
+}
+
+} // anonymous namespace
 
 
 ProxyModel::ProxyModel(QObject *parent)
-    : QSortFilterProxyModel(parent)
+    : QSortFilterProxyModel(parent), indexed(false),
+      acceptedRowsValid(false)
 {
     m_minimumZipcode = m_maximumZipcode = InvalidZipcode;
 }
 
 
+// Our connections are made before the base class's so that the indexes
+// are up to date before it asks filterAcceptsRow() about any rows
+void ProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (QAbstractItemModel *oldModel = this->sourceModel()) {
+        disconnect(oldModel, 0, this, SLOT(clearIndexes()));
+        disconnect(oldModel, 0, this, SLOT(sourceDataChanged(
+                const QModelIndex&, const QModelIndex&)));
+        disconnect(oldModel, 0, this, SLOT(sourceRowsInserted(
+                const QModelIndex&, int, int)));
+        disconnect(oldModel, 0, this, SLOT(sourceRowsRemoved(
+                const QModelIndex&, int, int)));
+    }
+    if (sourceModel) {
+        connect(sourceModel, SIGNAL(modelReset()),
+                this, SLOT(clearIndexes()));
+        connect(sourceModel, SIGNAL(layoutChanged()),
+                this, SLOT(clearIndexes()));
+        connect(sourceModel,
+            SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)),
+            this, SLOT(sourceDataChanged(const QModelIndex&,
+                                         const QModelIndex&)));
+        connect(sourceModel,
+                SIGNAL(rowsInserted(const QModelIndex&, int, int)),
+                this, SLOT(sourceRowsInserted(const QModelIndex&, int,
+                                              int)));
+        connect(sourceModel,
+                SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
+                this, SLOT(sourceRowsRemoved(const QModelIndex&, int,
+                                             int)));
+        connect(sourceModel, SIGNAL(rowsMoved(const QModelIndex&, int,
+                        int, const QModelIndex&, int)),
+                this, SLOT(clearIndexes()));
+    }
+    indexed = false;
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
+
 void ProxyModel::clearFilters()
 {
     m_minimumZipcode = m_maximumZipcode = InvalidZipcode;
     m_county.clear();
     m_state.clear();
+    filterChanged();
+}
+
+
+void ProxyModel::filterChanged()
+{
+    acceptedRowsValid = false;
     invalidateFilter();
 }
 
 
+// With no filters set every row is accepted without touching the
+// indexes; otherwise the accepted rows are worked out once per filter
+// change and each call here is just a lookup
 bool ProxyModel::filterAcceptsRow(int sourceRow,
         const QModelIndex &sourceParent) const
 {
-    if (m_minimumZipcode != InvalidZipcode ||
-        m_maximumZipcode != InvalidZipcode) {
-        QModelIndex index = sourceModel()->index(sourceRow, Zipcode,
-                                                 sourceParent);
-        if (m_minimumZipcode != InvalidZipcode &&
-            sourceModel()->data(index).toInt() < m_minimumZipcode)
-            return false;
-        if (m_maximumZipcode != InvalidZipcode &&
-            sourceModel()->data(index).toInt() > m_maximumZipcode)
-            return false;
-    }
-    if (!m_county.isEmpty()) {
-        QModelIndex index = sourceModel()->index(sourceRow, County,
-                                                 sourceParent);
-        if (m_county != sourceModel()->data(index).toString())
-            return false;
-    }
-    if (!m_state.isEmpty()) {
-        QModelIndex index = sourceModel()->index(sourceRow, State,
-                                                 sourceParent);
-        if (m_state != sourceModel()->data(index).toString())
-            return false;
+    if (sourceParent.isValid())
+        return false;
+    if (m_minimumZipcode == InvalidZipcode &&
+        m_maximumZipcode == InvalidZipcode &&
+        m_county.isEmpty() && m_state.isEmpty())
+        return true;
+    if (!indexed)
+        buildIndexes();
+    if (!acceptedRowsValid)
+        updateAcceptedRows();
+    return sourceRow >= 0 && sourceRow < acceptedRows.count() &&
+           acceptedRows.at(sourceRow);
+}
+
+
+// Every row starts out unindexed and is indexed as if just changed
+void ProxyModel::buildIndexes() const
+{
+    const int rows = sourceModel() ? sourceModel()->rowCount() : 0;
+    zipcodeForRow.fill(InvalidZipcode, rows);
+    countyForRow.fill(Unindexed, rows);
+    stateForRow.fill(Unindexed, rows);
+    rowsByZipcode.clear();
+    countyIds.clear();
+    stateIds.clear();
+    rowsForCounty.clear();
+    rowsForState.clear();
+    acceptedRowsValid = false;
+    if (rows > 0)
+        reindexRows(0, rows - 1);
+    indexed = true;
+}
+
+
+// Only the rows' own entries are touched, so a chunk of inserted or
+// changed rows costs one pass over the zipcode order rather than a
+// rebuild of every index
+void ProxyModel::sourceDataChanged(const QModelIndex &topLeft,
+                                   const QModelIndex &bottomRight)
+{
+    if (!indexed || topLeft.parent().isValid())
+        return;
+    for (int column = topLeft.column(); column <= bottomRight.column();
+         ++column) {
+        if (column == Zipcode || column == County || column == State) {
+            reindexRows(topLeft.row(), bottomRight.row());
+            return;
+        }
+    }
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        if (countyForRow.at(row) == Unindexed) {
+            reindexRows(topLeft.row(), bottomRight.row());
+            return;
+        }
+    }
+}
+
+
+void ProxyModel::sourceRowsInserted(const QModelIndex &parent,
+                                    int first, int last)
+{
+    if (!indexed || parent.isValid())
+        return;
+    const int count = last - first + 1;
+    if (first < zipcodeForRow.count()) {
+        shiftRows(&rowsByZipcode, first, count);
+        for (int i = 0; i < rowsForCounty.count(); ++i)
+            shiftRows(&rowsForCounty[i], first, count);
+        for (int i = 0; i < rowsForState.count(); ++i)
+            shiftRows(&rowsForState[i], first, count);
+    }
+    zipcodeForRow.insert(first, count, InvalidZipcode);
+    countyForRow.insert(first, count, Unindexed);
+    stateForRow.insert(first, count, Unindexed);
+    if (acceptedRowsValid)
+        acceptedRows.insert(first, count, false);
+    reindexRows(first, last);
+}
+
+
+void ProxyModel::sourceRowsRemoved(const QModelIndex &parent,
+                                   int first, int last)
+{
+    if (!indexed || parent.isValid())
+        return;
+    const int count = last - first + 1;
+    removeRows(&rowsByZipcode, first, last);
+    for (int i = 0; i < rowsForCounty.count(); ++i)
+        removeRows(&rowsForCounty[i], first, last);
+    for (int i = 0; i < rowsForState.count(); ++i)
+        removeRows(&rowsForState[i], first, last);
+    zipcodeForRow.remove(first, count);
+    countyForRow.remove(first, count);
+    stateForRow.remove(first, count);
+    if (acceptedRowsValid)
+        acceptedRows.remove(first, count);
+}
+
+
+void ProxyModel::reindexRows(int first, int last) const
+{
+    QSet<int> oldCountyIds;
+    QSet<int> oldStateIds;
+    for (int row = first; row <= last; ++row) {
+        if (countyForRow.at(row) != Unindexed)
+            oldCountyIds << countyForRow.at(row);
+        if (stateForRow.at(row) != Unindexed)
+            oldStateIds << stateForRow.at(row);
+    }
+    foreach (const int id, oldCountyIds)
+        removeRange(&rowsForCounty[id], first, last);
+    foreach (const int id, oldStateIds)
+        removeRange(&rowsForState[id], first, last);
+
+    QMap<int, QVector<int> > newRowsForCounty;
+    QMap<int, QVector<int> > newRowsForState;
+    QVector<int> changedRows;
+    changedRows.reserve(last - first + 1);
+    for (int row = first; row <= last; ++row) {
+        if (!hasData(row)) {
+            zipcodeForRow[row] = InvalidZipcode;
+            countyForRow[row] = stateForRow[row] = Unindexed;
+            continue;
+        }
+        zipcodeForRow[row] = sourceModel()->data(
+                sourceModel()->index(row, Zipcode)).toInt();
+        const int countyId = idFor(&countyIds, &rowsForCounty,
+                sourceModel()->data(sourceModel()->index(row, County))
+                        .toString());
+        countyForRow[row] = countyId;
+        newRowsForCounty[countyId] << row;
+        const int stateId = idFor(&stateIds, &rowsForState,
+                sourceModel()->data(sourceModel()->index(row, State))
+                        .toString());
+        stateForRow[row] = stateId;
+        newRowsForState[stateId] << row;
+        changedRows << row;
+    }
+    QMapIterator<int, QVector<int> > i(newRowsForCounty);
+    while (i.hasNext()) {
+        i.next();
+        insertRange(&rowsForCounty[i.key()], i.value());
+    }
+    QMapIterator<int, QVector<int> > j(newRowsForState);
+    while (j.hasNext()) {
+        j.next();
+        insertRange(&rowsForState[j.key()], j.value());
+    }
+
+    if (changedRows.isEmpty() && oldCountyIds.isEmpty())
+        return; // None were or are indexed, so none are accepted
+    ZipcodeLessThan lessThan(zipcodeForRow);
+    qSort(changedRows.begin(), changedRows.end(), lessThan);
+    QVector<int> merged;
+    merged.reserve(rowsByZipcode.count() + changedRows.count());
+    int k = 0;
+    foreach (const int row, rowsByZipcode) {
+        if (row >= first && row <= last)
+            continue;
+        while (k < changedRows.count() && lessThan(changedRows.at(k), row))
+            merged << changedRows.at(k++);
+        merged << row;
     }
+    while (k < changedRows.count())
+        merged << changedRows.at(k++);
+    rowsByZipcode = merged;
+
+    if (acceptedRowsValid)
+        for (int row = first; row <= last; ++row)
+            acceptedRows[row] = rowMatches(row);
+}
+
+
+bool ProxyModel::hasData(int row) const
+{
+    return sourceModel()->data(sourceModel()->index(row, Zipcode))
+                .isValid() ||
+           sourceModel()->data(sourceModel()->index(row, County))
+                .isValid() ||
+           sourceModel()->data(sourceModel()->index(row, State))
+                .isValid();
+}
+
+
+bool ProxyModel::rowMatches(int row) const
+{
+    if (countyForRow.at(row) == Unindexed)
+        return false;
+    const int zipcode = zipcodeForRow.at(row);
+    if (m_minimumZipcode != InvalidZipcode && zipcode < m_minimumZipcode)
+        return false;
+    if (m_maximumZipcode != InvalidZipcode && zipcode > m_maximumZipcode)
+        return false;
+    if (!m_county.isEmpty() &&
+        countyForRow.at(row) != countyIds.value(m_county, NoMatch))
+        return false;
+    if (!m_state.isEmpty() &&
+        stateForRow.at(row) != stateIds.value(m_state, NoMatch))
+        return false;
     return true;
 }
 
 
+void ProxyModel::updateAcceptedRows() const
+{
+    acceptedRows.fill(false, zipcodeForRow.count());
+    foreach (const int row, sourceRowsMatching(m_minimumZipcode,
+                m_maximumZipcode, m_county, m_state))
+        acceptedRows[row] = true;
+    acceptedRowsValid = true;
+}
+
+
+// Returns the source rows that match the given criteria in ascending
+// order; an InvalidZipcode or an empty string matches anything. Only
+// the smallest of the zipcode range, the county's rows and the state's
+// rows is walked, with the other criteria checked against each row.
+QVector<int> ProxyModel::sourceRowsMatching(int minimumZipcode,
+        int maximumZipcode, const QString &county,
+        const QString &state) const
+{
+    if (!indexed)
+        buildIndexes();
+    QVector<int> rows;
+    int countyId = NoFilter;
+    if (!county.isEmpty())
+        countyId = countyIds.value(county, NoMatch);
+    int stateId = NoFilter;
+    if (!state.isEmpty())
+        stateId = stateIds.value(state, NoMatch);
+    if (countyId == NoMatch || stateId == NoMatch)
+        return rows;
+
+    int first = 0;
+    int last = rowsByZipcode.count();
+    if (minimumZipcode != InvalidZipcode)
+        first = lowerBound(rowsByZipcode, zipcodeForRow, minimumZipcode);
+    if (maximumZipcode != InvalidZipcode)
+        last = lowerBound(rowsByZipcode, zipcodeForRow,
+                          maximumZipcode + 1);
+    if (first >= last)
+        return rows;
+
+    const QVector<int> *candidates = 0;
+    int count = last - first;
+    if (countyId != NoFilter &&
+        rowsForCounty.at(countyId).count() < count) {
+        candidates = &rowsForCounty.at(countyId);
+        count = candidates->count();
+    }
+    if (stateId != NoFilter && rowsForState.at(stateId).count() < count)
+        candidates = &rowsForState.at(stateId);
+
+    if (!candidates) {
+        rows.reserve(count);
+        for (int i = first; i < last; ++i) {
+            const int row = rowsByZipcode.at(i);
+            if ((countyId == NoFilter || countyForRow.at(row) == countyId)
+                && (stateId == NoFilter || stateForRow.at(row) == stateId))
+                rows << row;
+        }
+        qSort(rows);
+        return rows;
+    }
+    const int lowest = zipcodeForRow.at(rowsByZipcode.at(first));
+    const int highest = zipcodeForRow.at(rowsByZipcode.at(last - 1));
+    foreach (const int row, *candidates) { // Already in row order
+        const int zipcode = zipcodeForRow.at(row);
+        if (zipcode < lowest || zipcode > highest)
+            continue;
+        if (countyId != NoFilter && countyForRow.at(row) != countyId)
+            continue;
+        if (stateId != NoFilter && stateForRow.at(row) != stateId)
+            continue;
+        rows << row;
+    }
+    return rows;
+}
+
+
 void ProxyModel::setMinimumZipcode(int minimumZipcode)
 {
     if (m_minimumZipcode != minimumZipcode) {
         m_minimumZipcode = minimumZipcode;
-        invalidateFilter();
+        filterChanged();
     }
 }
 
@@ -74,7 +485,7 @@ void ProxyModel::setMaximumZipcode(int maximumZipcode)
 {
     if (m_maximumZipcode != maximumZipcode) {
         m_maximumZipcode = maximumZipcode;
-        invalidateFilter();
+        filterChanged();
     }
 }
 
@@ -83,7 +494,7 @@ void ProxyModel::setCounty(const QString &county)
 {
     if (m_county != county) {
         m_county = county;
-        invalidateFilter();
+        filterChanged();
     }
 }
 
@@ -92,6 +503,6 @@ void ProxyModel::setState(const QString &state)
 {
     if (m_state != state) {
         m_state = state;
-        invalidateFilter();
+        filterChanged();
     }
 }
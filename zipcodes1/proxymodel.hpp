@@ -14,7 +14,9 @@
 */
 
 
+#include <QHash>
 #include <QSortFilterProxyModel>
+#include <QVector>
 
 
 class ProxyModel : public QSortFilterProxyModel
@@ -24,10 +26,14 @@ class ProxyModel : public QSortFilterProxyModel
 public:
     explicit ProxyModel(QObject *parent=0);
 
+    void setSourceModel(QAbstractItemModel *sourceModel);
     int minimumZipcode() const { return m_minimumZipcode; }
     int maximumZipcode() const { return m_maximumZipcode; }
     QString county() const { return m_county; }
     QString state() const { return m_state; }
+    QVector<int> sourceRowsMatching(int minimumZipcode,
+            int maximumZipcode, const QString &county,
+            const QString &state) const;
 
 public slots:
     void clearFilters();
@@ -40,11 +46,45 @@ protected:
     bool filterAcceptsRow(int sourceRow,
                           const QModelIndex &sourceParent) const;
 
+private slots:
+    void clearIndexes() { indexed = false; }
+    void sourceDataChanged(const QModelIndex &topLeft,
+                           const QModelIndex &bottomRight);
+    void sourceRowsInserted(const QModelIndex &parent, int first,
+                            int last);
+    void sourceRowsRemoved(const QModelIndex &parent, int first,
+                           int last);
+
 private:
+    void filterChanged();
+    void buildIndexes() const;
+    void reindexRows(int first, int last) const;
+    bool hasData(int row) const;
+    bool rowMatches(int row) const;
+    void updateAcceptedRows() const;
+
     int m_minimumZipcode;
     int m_maximumZipcode;
     QString m_county;
     QString m_state;
+
+    // Built from the source model the first time a filter is applied,
+    // kept up to date as source rows are inserted, removed or changed,
+    // and only rebuilt after a reset, layout change or move; the
+    // counties and states are held as ids into countyIds and stateIds.
+    // Rows with no data yet are left out of the indexes (with Unindexed
+    // ids) until a dataChanged() fills them in.
+    mutable bool indexed;
+    mutable bool acceptedRowsValid;
+    mutable QVector<int> zipcodeForRow;
+    mutable QVector<int> countyForRow;
+    mutable QVector<int> stateForRow;
+    mutable QVector<int> rowsByZipcode;
+    mutable QHash<QString, int> countyIds;
+    mutable QHash<QString, int> stateIds;
+    mutable QVector<QVector<int> > rowsForCounty;
+    mutable QVector<QVector<int> > rowsForState;
+    mutable QVector<bool> acceptedRows;
 };
 
 #endif // PROXYMODEL_HPP
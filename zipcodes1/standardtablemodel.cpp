@@ -14,20 +14,30 @@
 #include "aqp.hpp"
 #include "global.hpp"
 #include "standardtablemodel.hpp"
+#include "zipcodefile.hpp"
 #include <QDataStream>
 #include <QFile>
+#include <QMap>
+#include <QTimer>
+#include <QtConcurrentRun>
 
 
 namespace {
-const qint32 MagicNumber = 0x5A697043;
-const qint16 FormatNumber = 100;
+const int ChunkRows = 2000;
 }
 
 
 StandardTableModel::StandardTableModel(QObject *parent)
-    : QStandardItemModel(parent)
+    : QStandardItemModel(parent), inserted(0)
 {
     initialize();
+    connect(&reader, SIGNAL(finished()), this, SLOT(readFinished()));
+}
+
+
+StandardTableModel::~StandardTableModel()
+{
+    reader.waitForFinished();
 }
 
 
@@ -38,8 +48,16 @@ void StandardTableModel::initialize()
 }
 
 
+bool StandardTableModel::isLoading() const
+{
+    return reader.isRunning() || !pending.isEmpty();
+}
+
+
 void StandardTableModel::clear()
 {
+    pending.clear();
+    inserted = 0;
     QStandardItemModel::clear();
     initialize();
 }
@@ -58,36 +76,157 @@ void StandardTableModel::load(const QString &filename)
     QDataStream in(&file);
     qint32 magicNumber;
     in >> magicNumber;
-    if (magicNumber != MagicNumber)
+    if (magicNumber != ZipcodeFile::MagicNumber)
         throw AQP::Error(tr("unrecognized file type"));
     qint16 formatVersionNumber;
     in >> formatVersionNumber;
-    if (formatVersionNumber > FormatNumber)
+    if (formatVersionNumber > ZipcodeFile::FormatNumber)
         throw AQP::Error(tr("file format version is too new"));
-    in.setVersion(QDataStream::Qt_4_5);
+    file.close();
+
+    reader.waitForFinished(); // In case a previous load is still reading
     clear();
+    reader.setFuture(QtConcurrent::run(&StandardTableModel::readRows,
+                                       m_filename));
+}
 
-    quint16 zipcode;
-    QString postOffice;
-    QString county;
-    QString state;
-    QMap<quint16, QList<QStandardItem*> > itemsForZipcode;
 
-    while (!in.atEnd()) {
-        in >> zipcode >> postOffice >> county >> state;
-        QList<QStandardItem*> items;
-        QStandardItem *item = new QStandardItem;
-        item->setData(zipcode, Qt::EditRole);
-        items << item;
-        foreach (const QString &text, QStringList() << postOffice
-                                      << county << state)
-            items << new QStandardItem(text);
-        itemsForZipcode[zipcode] = items;
+// Runs in a worker thread, so errors are passed back rather than thrown
+StandardTableModel::Rows StandardTableModel::readRows(
+        const QString &filename)
+{
+    Rows result;
+    try {
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadOnly))
+            throw AQP::Error(file.errorString());
+        QDataStream in(&file);
+        qint32 magicNumber;
+        qint16 formatVersionNumber;
+        in >> magicNumber >> formatVersionNumber;
+        if (formatVersionNumber == ZipcodeFile::FormatNumber) {
+            file.close();
+            readMapped(filename, &result.rows);
+        }
+        else
+            readStream(in, &result.rows);
+    } catch (AQP::Error &error) {
+        result.rows.clear();
+        result.error = QString::fromUtf8(error.what());
     }
+    return result;
+}
 
-    QMapIterator<quint16, QList<QStandardItem*> > i(itemsForZipcode);
+
+void StandardTableModel::readStream(QDataStream &in, QVector<Row> *rows)
+{
+    in.setVersion(QDataStream::Qt_4_5);
+    quint16 zipcode;
+    Row row;
+    QMap<quint16, Row> rowForZipcode;
+    while (!in.atEnd()) {
+        in >> zipcode >> row.postOffice >> row.county >> row.state;
+        if (in.status() != QDataStream::Ok)
+            throw AQP::Error(tr("corrupt file"));
+        row.zipcode = zipcode;
+        rowForZipcode[zipcode] = row;
+    }
+    rows->reserve(rowForZipcode.count());
+    QMapIterator<quint16, Row> i(rowForZipcode);
     while (i.hasNext())
-        appendRow(i.next().value());
+        *rows << i.next().value();
+}
+
+
+// The rows are already in zipcode order so they can be taken as they
+// are; each distinct string is decoded only once. As with the old
+// format only the last row for any given zipcode is kept.
+void StandardTableModel::readMapped(const QString &filename,
+                                    QVector<Row> *rows)
+{
+    ZipcodeFile zipcodeFile;
+    zipcodeFile.open(filename);
+    QVector<QString> strings(zipcodeFile.stringCount());
+    QVector<bool> decoded(zipcodeFile.stringCount(), false);
+    rows->reserve(zipcodeFile.rowCount());
+    for (int i = 0; i < zipcodeFile.rowCount(); ++i) {
+        const int zipcode = zipcodeFile.zipcode(i);
+        if (i + 1 < zipcodeFile.rowCount() &&
+            zipcodeFile.zipcode(i + 1) == zipcode)
+            continue;
+        const quint32 ids[] = {zipcodeFile.postOfficeId(i),
+                zipcodeFile.countyId(i), zipcodeFile.stateId(i)};
+        QString texts[3];
+        for (int j = 0; j < 3; ++j) {
+            const quint32 id = ids[j];
+            if (id >= static_cast<quint32>(strings.count()))
+                continue;
+            if (!decoded.at(id)) {
+                strings[id] = zipcodeFile.string(id);
+                decoded[id] = true;
+            }
+            texts[j] = strings.at(id);
+        }
+        Row row;
+        row.zipcode = zipcode;
+        row.postOffice = texts[0];
+        row.county = texts[1];
+        row.state = texts[2];
+        *rows << row;
+    }
+}
+
+
+void StandardTableModel::readFinished()
+{
+    Rows result = reader.result();
+    if (!result.error.isEmpty()) {
+        emit loadFailed(result.error);
+        return;
+    }
+    pending = result.rows;
+    inserted = 0;
+    if (pending.isEmpty())
+        emit loaded();
+    else
+        insertChunk();
+}
+
+
+// Each chunk is announced by a single rowsInserted() and a single
+// dataChanged() rather than by a signal per row, and control goes back
+// to the event loop between chunks so the view stays usable. The rows
+// are still empty when they're inserted, so the proxies leave them
+// alone until the dataChanged().
+void StandardTableModel::insertChunk()
+{
+    if (pending.isEmpty())
+        return;
+    const int first = rowCount();
+    const int count = qMin(ChunkRows, pending.count() - inserted);
+    insertRows(first, count);
+    const bool blocked = blockSignals(true);
+    for (int i = 0; i < count; ++i) {
+        const Row &row = pending.at(inserted + i);
+        QStandardItem *item = new QStandardItem;
+        item->setData(row.zipcode, Qt::EditRole);
+        setItem(first + i, Zipcode, item);
+        setItem(first + i, PostOffice, new QStandardItem(row.postOffice));
+        setItem(first + i, County, new QStandardItem(row.county));
+        setItem(first + i, State, new QStandardItem(row.state));
+    }
+    blockSignals(blocked);
+    emit dataChanged(index(first, Zipcode),
+                     index(first + count - 1, State));
+    inserted += count;
+    emit loadProgress(inserted, pending.count());
+    if (inserted < pending.count())
+        QTimer::singleShot(0, this, SLOT(insertChunk()));
+    else {
+        pending.clear();
+        inserted = 0;
+        emit loaded();
+    }
 }
 
 
@@ -97,17 +236,12 @@ void StandardTableModel::save(const QString &filename)
         m_filename = filename;
     if (m_filename.isEmpty())
         throw AQP::Error(tr("no filename specified"));
-    QFile file(m_filename);
-    if (!file.open(QIODevice::WriteOnly))
-        throw AQP::Error(file.errorString());
 
-    QDataStream out(&file);
-    out << MagicNumber << FormatNumber;
-    out.setVersion(QDataStream::Qt_4_5);
-    for (int row = 0; row < rowCount(); ++row) {
-        out << static_cast<quint16>(
-                    item(row, Zipcode)->data(Qt::EditRole).toUInt())
-            << item(row, PostOffice)->text()
-            << item(row, County)->text() << item(row, State)->text();
-    }
+    ZipcodeFileWriter writer;
+    writer.reserve(rowCount());
+    for (int row = 0; row < rowCount(); ++row)
+        writer.addRow(item(row, Zipcode)->data(Qt::EditRole).toInt(),
+                      item(row, PostOffice)->text(),
+                      item(row, County)->text(), item(row, State)->text());
+    writer.save(m_filename);
 }
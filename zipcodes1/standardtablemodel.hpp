@@ -13,7 +13,9 @@
     the GNU General Public License for more details.
 */
 
+#include <QFutureWatcher>
 #include <QStandardItemModel>
+#include <QVector>
 
 
 class StandardTableModel : public QStandardItemModel
@@ -22,16 +24,48 @@ class StandardTableModel : public QStandardItemModel
 
 public:
     explicit StandardTableModel(QObject *parent=0);
+    ~StandardTableModel();
 
     QString filename() const { return m_filename; }
+    bool isLoading() const;
     void clear();
     void load(const QString &filename=QString());
     void save(const QString &filename=QString());
 
+signals:
+    void loadProgress(int done, int total);
+    void loaded();
+    void loadFailed(const QString &message);
+
+private slots:
+    void readFinished();
+    void insertChunk();
+
 private:
+    struct Row
+    {
+        int zipcode;
+        QString postOffice;
+        QString county;
+        QString state;
+    };
+    struct Rows
+    {
+        QVector<Row> rows;
+        QString error;
+    };
+
     void initialize();
+    static Rows readRows(const QString &filename);
+    static void readStream(QDataStream &in, QVector<Row> *rows);
+    static void readMapped(const QString &filename, QVector<Row> *rows);
 
     QString m_filename;
+    // Rows are read in a worker thread, then handed to the model a
+    // chunk at a time from the event loop
+    QFutureWatcher<Rows> reader;
+    QVector<Row> pending;
+    int inserted;
 };
 
 #endif // STANDARDTABLEMODEL_HPP
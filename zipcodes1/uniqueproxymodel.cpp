@@ -12,25 +12,213 @@
 */
 
 #include "uniqueproxymodel.hpp"
+#include <QtAlgorithms>
 
 
 void UniqueProxyModel::setSourceModel(
         QAbstractItemModel *sourceModel)
 {
-    connect(sourceModel, SIGNAL(modelReset()),
-            this, SLOT(clearCache()));
-    QSortFilterProxyModel::setSourceModel(sourceModel);
+    if (this->sourceModel())
+        disconnect(this->sourceModel(), 0, this, 0);
+    QAbstractProxyModel::setSourceModel(sourceModel);
+    if (sourceModel) {
+        connect(sourceModel, SIGNAL(modelReset()),
+                this, SLOT(rebuild()));
+        connect(sourceModel, SIGNAL(layoutChanged()),
+                this, SLOT(rebuild()));
+        connect(sourceModel, SIGNAL(rowsMoved(const QModelIndex&, int,
+                        int, const QModelIndex&, int)),
+                this, SLOT(rebuild()));
+        connect(sourceModel,
+            SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)),
+            this, SLOT(sourceDataChanged(const QModelIndex&,
+                                         const QModelIndex&)));
+        connect(sourceModel,
+                SIGNAL(rowsInserted(const QModelIndex&, int, int)),
+                this, SLOT(sourceRowsInserted(const QModelIndex&, int,
+                                              int)));
+        connect(sourceModel,
+                SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
+                this, SLOT(sourceRowsRemoved(const QModelIndex&, int,
+                                             int)));
+    }
+    rebuild();
 }
 
 
-bool UniqueProxyModel::filterAcceptsRow(int sourceRow,
-        const QModelIndex &sourceParent) const
+QModelIndex UniqueProxyModel::index(int row, int column,
+        const QModelIndex &parent) const
 {
-    QModelIndex index = sourceModel()->index(sourceRow, Column,
-                                             sourceParent);
-    const QString &text = sourceModel()->data(index).toString();
-    if (cache.contains(text))
-        return false;
-    cache << text;
-    return true;
+    if (parent.isValid() || row < 0 || row >= values.count() ||
+        column < 0 || column >= columnCount())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+
+int UniqueProxyModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : values.count();
+}
+
+
+int UniqueProxyModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !sourceModel())
+        return 0;
+    return sourceModel()->columnCount();
+}
+
+
+QVariant UniqueProxyModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+    if (index.column() == Column &&
+        (role == Qt::DisplayRole || role == Qt::EditRole))
+        return values.at(index.row());
+    return QAbstractProxyModel::data(index, role);
+}
+
+
+QModelIndex UniqueProxyModel::mapToSource(
+        const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid() || !sourceModel())
+        return QModelIndex();
+    const QString &value = values.at(proxyIndex.row());
+    QPersistentModelIndex &index = indexForValue[value];
+    if (!index.isValid() || index.row() >= valueForRow.count() ||
+        valueForRow.at(index.row()) != value) {
+        const int row = valueForRow.indexOf(value);
+        Q_ASSERT(row != -1);
+        index = sourceModel()->index(row, Column);
+    }
+    return sourceModel()->index(index.row(), proxyIndex.column());
+}
+
+
+QModelIndex UniqueProxyModel::mapFromSource(
+        const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.parent().isValid() ||
+        sourceIndex.row() >= valueForRow.count() ||
+        valueForRow.at(sourceIndex.row()).isNull())
+        return QModelIndex();
+    return index(rowForValue(valueForRow.at(sourceIndex.row())),
+                 sourceIndex.column());
+}
+
+
+void UniqueProxyModel::rebuild()
+{
+    beginResetModel();
+    valueForRow.clear();
+    values.clear();
+    countForValue.clear();
+    indexForValue.clear();
+    const int rows = sourceModel() ? sourceModel()->rowCount() : 0;
+    valueForRow.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        const QString value = sourceValue(row);
+        valueForRow << value;
+        if (!value.isNull() && ++countForValue[value] == 1)
+            values << value;
+    }
+    qSort(values);
+    endResetModel();
+}
+
+
+void UniqueProxyModel::sourceDataChanged(const QModelIndex &topLeft,
+        const QModelIndex &bottomRight)
+{
+    if (topLeft.parent().isValid() || topLeft.column() > Column ||
+        bottomRight.column() < Column)
+        return;
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        const QString value = sourceValue(row);
+        const QString oldValue = valueForRow.at(row);
+        if (value == oldValue && value.isNull() == oldValue.isNull())
+            continue;
+        if (!value.isNull())
+            addValue(value);
+        if (!oldValue.isNull())
+            removeValue(oldValue);
+        valueForRow[row] = value;
+    }
+}
+
+
+void UniqueProxyModel::sourceRowsInserted(const QModelIndex &parent,
+        int first, int last)
+{
+    if (parent.isValid())
+        return;
+    valueForRow.insert(first, last - first + 1, QString());
+    for (int row = first; row <= last; ++row) {
+        const QString value = sourceValue(row);
+        if (!value.isNull()) {
+            valueForRow[row] = value;
+            addValue(value);
+        }
+    }
+}
+
+
+void UniqueProxyModel::sourceRowsRemoved(const QModelIndex &parent,
+        int first, int last)
+{
+    if (parent.isValid())
+        return;
+    for (int row = first; row <= last; ++row)
+        if (!valueForRow.at(row).isNull())
+            removeValue(valueForRow.at(row));
+    valueForRow.remove(first, last - first + 1);
+}
+
+
+// Returns a null string if the row has no data yet; an empty value is
+// returned as an empty but non-null string
+QString UniqueProxyModel::sourceValue(int row) const
+{
+    const QVariant value = sourceModel()->data(
+            sourceModel()->index(row, Column));
+    if (!value.isValid())
+        return QString();
+    const QString text = value.toString();
+    return text.isNull() ? QString("") : text;
+}
+
+
+int UniqueProxyModel::rowForValue(const QString &value) const
+{
+    return qLowerBound(values.constBegin(), values.constEnd(), value) -
+           values.constBegin();
+}
+
+
+void UniqueProxyModel::addValue(const QString &value)
+{
+    if (++countForValue[value] > 1)
+        return;
+    const int row = rowForValue(value);
+    beginInsertRows(QModelIndex(), row, row);
+    values.insert(row, value);
+    endInsertRows();
+}
+
+
+void UniqueProxyModel::removeValue(const QString &value)
+{
+    QHash<QString, int>::iterator i = countForValue.find(value);
+    Q_ASSERT(i != countForValue.end());
+    if (--i.value() > 0)
+        return;
+    countForValue.erase(i);
+    indexForValue.remove(value);
+    const int row = rowForValue(value);
+    beginRemoveRows(QModelIndex(), row, row);
+    values.removeAt(row);
+    endRemoveRows();
 }
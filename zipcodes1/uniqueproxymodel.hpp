@@ -14,30 +14,64 @@
 */
 
 
-#include <QSet>
-#include <QSortFilterProxyModel>
+#include <QAbstractProxyModel>
+#include <QHash>
+#include <QPersistentModelIndex>
+#include <QStringList>
+#include <QVector>
 
 
-class UniqueProxyModel : public QSortFilterProxyModel
+// Presents the distinct values of one of the source model's columns in
+// ascending order. Every value has a reference count of the source rows
+// that hold it, and the counts are kept up to date as source rows are
+// changed, inserted and removed, so a value only appears or disappears
+// when the first row gets it or the last row loses it. Rows inserted
+// without any data (e.g., before a chunk of rows is filled in) aren't
+// counted until a dataChanged() gives them some.
+
+class UniqueProxyModel : public QAbstractProxyModel
 {
     Q_OBJECT
 
 public:
     explicit UniqueProxyModel(int column, QObject *parent=0)
-        : QSortFilterProxyModel(parent), Column(column) {}
+        : QAbstractProxyModel(parent), Column(column) {}
 
     void setSourceModel(QAbstractItemModel *sourceModel);
 
-protected:
-    bool filterAcceptsRow(int sourceRow,
-                          const QModelIndex &sourceParent) const;
+    QModelIndex index(int row, int column,
+                      const QModelIndex &parent=QModelIndex()) const;
+    QModelIndex parent(const QModelIndex&) const
+        { return QModelIndex(); }
+    int rowCount(const QModelIndex &parent=QModelIndex()) const;
+    int columnCount(const QModelIndex &parent=QModelIndex()) const;
+    QVariant data(const QModelIndex &index,
+                  int role=Qt::DisplayRole) const;
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const;
 
 private slots:
-    void clearCache() { cache.clear(); }
+    void rebuild();
+    void sourceDataChanged(const QModelIndex &topLeft,
+                           const QModelIndex &bottomRight);
+    void sourceRowsInserted(const QModelIndex &parent, int first,
+                            int last);
+    void sourceRowsRemoved(const QModelIndex &parent, int first,
+                           int last);
 
 private:
+    QString sourceValue(int row) const;
+    int rowForValue(const QString &value) const;
+    void addValue(const QString &value);
+    void removeValue(const QString &value);
+
     const int Column;
-    mutable QSet<QString> cache;
+    QVector<QString> valueForRow; // One per source row; null if none
+    QStringList values;
+    QHash<QString, int> countForValue;
+    // Any one source row holding the value; found again if it is lost
+    mutable QHash<QString, QPersistentModelIndex> indexForValue;
 };
 
 #endif // UNIQUEPROXYMODEL_HPP
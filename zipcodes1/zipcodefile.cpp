@@ -0,0 +1,280 @@
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include "aqp.hpp"
+#include "zipcodefile.hpp"
+#include <QDataStream>
+#include <QPair>
+#include <QtAlgorithms>
+#include <QtEndian>
+#include <climits>
+
+
+namespace {
+const qint64 HeaderSize = 40;
+const int RowFields = 4;
+const qint64 RowSize = RowFields * sizeof(quint32);
+
+
+class RowLessThan
+{
+public:
+    RowLessThan(const QVector<quint32> &rows,
+                const QVector<QString> &strings)
+        : rows(rows), strings(strings) {}
+
+    bool operator()(int a, int b) const
+    {
+        const int zipcodeA = static_cast<int>(rows.at(a * RowFields));
+        const int zipcodeB = static_cast<int>(rows.at(b * RowFields));
+        if (zipcodeA != zipcodeB)
+            return zipcodeA < zipcodeB;
+        return strings.at(rows.at((a * RowFields) + 1)) <
+               strings.at(rows.at((b * RowFields) + 1));
+    }
+
+private:
+    const QVector<quint32> &rows;
+    const QVector<QString> &strings;
+};
+
+} // anonymous namespace
+
+
+void ZipcodeFile::open(const QString &filename)
+{
+    close();
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly))
+        throw AQP::Error(m_file.errorString());
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        m_buffer = m_file.readAll();
+        m_data = reinterpret_cast<const uchar*>(m_buffer.constData());
+    }
+
+    try {
+        if (m_size < HeaderSize ||
+            qFromBigEndian<qint32>(m_data) != MagicNumber)
+            throw AQP::Error(tr("unrecognized file type"));
+        const qint16 formatVersionNumber =
+                qFromBigEndian<qint16>(m_data + 4);
+        if (formatVersionNumber > FormatNumber)
+            throw AQP::Error(tr("file format version is too new"));
+        if (formatVersionNumber != FormatNumber)
+            throw AQP::Error(tr("file format version %1 cannot be "
+                                "mapped").arg(formatVersionNumber));
+
+        const quint32 rowCount = qFromLittleEndian<quint32>(m_data + 8);
+        const quint32 stringCount =
+                qFromLittleEndian<quint32>(m_data + 12);
+        const quint64 stringIndexOffset =
+                qFromLittleEndian<quint64>(m_data + 16);
+        const quint64 stringDataOffset =
+                qFromLittleEndian<quint64>(m_data + 24);
+        const quint64 rowsOffset = qFromLittleEndian<quint64>(m_data + 32);
+        const quint64 size = static_cast<quint64>(m_size);
+        // Each offset is checked on its own before the length that
+        // follows it, since adding them could wrap around
+        if (rowCount > static_cast<quint32>(INT_MAX) ||
+            stringCount >= static_cast<quint32>(INT_MAX) ||
+            stringIndexOffset > size ||
+            (static_cast<quint64>(stringCount) + 1) * sizeof(quint64) >
+                    size - stringIndexOffset ||
+            stringDataOffset > size || (stringDataOffset % 2) ||
+            rowsOffset > size ||
+            static_cast<quint64>(rowCount) * RowSize > size - rowsOffset)
+            throw AQP::Error(tr("corrupt file"));
+        m_stringIndex = m_data + stringIndexOffset;
+        m_rowCount = static_cast<int>(rowCount);
+        m_stringCount = static_cast<int>(stringCount);
+        m_strings = m_data + stringDataOffset;
+        m_stringsSize = size - stringDataOffset;
+        m_rows = m_data + rowsOffset;
+    } catch (AQP::Error&) {
+        close();
+        throw;
+    }
+}
+
+
+void ZipcodeFile::close()
+{
+    if (m_data && m_buffer.isEmpty())
+        m_file.unmap(const_cast<uchar*>(m_data));
+    m_buffer.clear();
+    m_file.close();
+    m_data = m_stringIndex = m_strings = m_rows = 0;
+    m_size = 0;
+    m_stringsSize = 0;
+    m_rowCount = m_stringCount = 0;
+}
+
+
+quint32 ZipcodeFile::field(int row, int column) const
+{
+    Q_ASSERT(row >= 0 && row < m_rowCount);
+    return qFromLittleEndian<quint32>(m_rows + (row * RowSize) +
+                                      (column * sizeof(quint32)));
+}
+
+
+// Returns false if the id is out of range or the string's offsets don't
+// lie within the string data
+bool ZipcodeFile::stringBounds(quint32 id, quint64 *begin,
+                               quint64 *end) const
+{
+    if (id >= static_cast<quint32>(m_stringCount))
+        return false;
+    *begin = qFromLittleEndian<quint64>(
+            m_stringIndex + (id * sizeof(quint64)));
+    *end = qFromLittleEndian<quint64>(
+            m_stringIndex + ((id + 1) * sizeof(quint64)));
+    return *begin <= *end && !(*begin % 2) && !(*end % 2) &&
+           *end <= m_stringsSize;
+}
+
+
+QString ZipcodeFile::string(quint32 id) const
+{
+    quint64 begin;
+    quint64 end;
+    if (!stringBounds(id, &begin, &end))
+        return QString();
+    const uchar *utf16 = m_strings + begin;
+    const int length = static_cast<int>((end - begin) / 2);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    return QString::fromUtf16(reinterpret_cast<const ushort*>(utf16),
+                              length);
+#else
+    QString text(length, Qt::Uninitialized);
+    for (int i = 0; i < length; ++i)
+        text[i] = QChar(qFromLittleEndian<quint16>(utf16 + (i * 2)));
+    return text;
+#endif
+}
+
+
+int ZipcodeFile::stringLength(quint32 id) const
+{
+    quint64 begin;
+    quint64 end;
+    if (!stringBounds(id, &begin, &end))
+        return 0;
+    return static_cast<int>((end - begin) / 2);
+}
+
+
+// Returns the ids of up to count of the longest distinct strings used
+// in the given column (PostOffice, County, or State). Their lengths
+// come from the string index, so no strings are decoded.
+QVector<quint32> ZipcodeFile::longestStrings(int column, int count) const
+{
+    QVector<bool> seen(m_stringCount, false);
+    QVector<QPair<int, quint32> > lengths;
+    for (int row = 0; row < m_rowCount; ++row) {
+        const quint32 id = field(row, column);
+        if (id < static_cast<quint32>(m_stringCount) && !seen.at(id)) {
+            seen[id] = true;
+            lengths << qMakePair(stringLength(id), id);
+        }
+    }
+    qSort(lengths.begin(), lengths.end(),
+          qGreater<QPair<int, quint32> >());
+    QVector<quint32> ids;
+    for (int i = 0; i < qMin(count, lengths.count()); ++i)
+        ids << lengths.at(i).second;
+    return ids;
+}
+
+
+void ZipcodeFileWriter::reserve(int rows)
+{
+    m_rows.reserve(rows * RowFields);
+}
+
+
+quint32 ZipcodeFileWriter::intern(const QString &text)
+{
+    QHash<QString, quint32>::const_iterator i =
+            m_idForString.constFind(text);
+    if (i != m_idForString.constEnd())
+        return i.value();
+    const quint32 id = static_cast<quint32>(m_strings.count());
+    m_strings << text;
+    m_idForString.insert(text, id);
+    return id;
+}
+
+
+void ZipcodeFileWriter::addRow(int zipcode, const QString &postOffice,
+        const QString &county, const QString &state)
+{
+    m_rows << static_cast<quint32>(zipcode) << intern(postOffice)
+           << intern(county) << intern(state);
+}
+
+
+void ZipcodeFileWriter::save(const QString &filename)
+{
+    if (filename.isEmpty())
+        throw AQP::Error(tr("no filename specified"));
+    const int rowCount = m_rows.count() / RowFields;
+    QVector<int> order(rowCount);
+    for (int i = 0; i < rowCount; ++i)
+        order[i] = i;
+    qStableSort(order.begin(), order.end(),
+                RowLessThan(m_rows, m_strings));
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+        throw AQP::Error(file.errorString());
+    QDataStream out(&file);
+    out << static_cast<qint32>(ZipcodeFile::MagicNumber)
+        << static_cast<qint16>(ZipcodeFile::FormatNumber)
+        << static_cast<quint16>(0);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    quint64 stringBytes = 0;
+    foreach (const QString &text, m_strings)
+        stringBytes += text.length() * 2;
+    const quint64 stringIndexOffset = HeaderSize;
+    const quint64 stringDataOffset = stringIndexOffset +
+            ((m_strings.count() + 1) * sizeof(quint64));
+    const quint64 rowsOffset = (stringDataOffset + stringBytes + 7) &
+                               ~Q_UINT64_C(7);
+    out << static_cast<quint32>(rowCount)
+        << static_cast<quint32>(m_strings.count())
+        << stringIndexOffset << stringDataOffset << rowsOffset;
+
+    quint64 offset = 0;
+    out << offset;
+    foreach (const QString &text, m_strings) {
+        offset += text.length() * 2;
+        out << offset;
+    }
+    foreach (const QString &text, m_strings) {
+        const ushort *utf16 = text.utf16();
+        for (int i = 0; i < text.length(); ++i)
+            out << static_cast<quint16>(utf16[i]);
+    }
+    for (quint64 i = stringDataOffset + stringBytes; i < rowsOffset; ++i)
+        out << static_cast<quint8>(0);
+    foreach (const int row, order) {
+        for (int i = 0; i < RowFields; ++i)
+            out << m_rows.at((row * RowFields) + i);
+    }
+    if (out.status() != QDataStream::Ok)
+        throw AQP::Error(tr("failed to write %1").arg(filename));
+}
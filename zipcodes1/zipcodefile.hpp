@@ -0,0 +1,114 @@
+#ifndef ZIPCODEFILE_HPP
+#define ZIPCODEFILE_HPP
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+
+// Format 200 zipcode files start with the same MagicNumber and format
+// number as the original QDataStream files, followed by a little-endian
+// header, a string table shared by all the text columns, and fixed-size
+// rows that are already sorted by zipcode and post office:
+//
+//  0 qint32 MagicNumber (big-endian)   4 qint16 format (big-endian)
+//  8 quint32 row count                12 quint32 string count
+// 16 quint64 string index offset      24 quint64 string data offset
+// 32 quint64 rows offset
+//
+// The string index holds string count + 1 quint64 offsets into the
+// UTF-16LE string data; each row is four quint32s: the zipcode and the
+// string ids of its post office, county and state. Since nothing needs
+// parsing up front the file is simply mapped and rows are decoded only
+// when they are asked for. Only the header's offsets are checked when
+// the file is opened, so opening costs the same however many rows and
+// strings there are; each string's offsets are checked when it is
+// read, and a corrupt string reads as an empty one.
+
+class ZipcodeFile
+{
+    Q_DECLARE_TR_FUNCTIONS(ZipcodeFile)
+
+public:
+    enum {MagicNumber = 0x5A697043, StreamFormatNumber = 100,
+          FormatNumber = 200};
+
+    explicit ZipcodeFile() : m_data(0), m_size(0), m_rowCount(0),
+        m_stringCount(0), m_stringIndex(0), m_strings(0),
+        m_stringsSize(0), m_rows(0) {}
+    ~ZipcodeFile() { close(); }
+
+    void open(const QString &filename);
+    void close();
+    bool isOpen() const { return m_data != 0; }
+
+    int rowCount() const { return m_rowCount; }
+    int stringCount() const { return m_stringCount; }
+    int zipcode(int row) const
+        { return static_cast<int>(field(row, 0)); }
+    quint32 postOfficeId(int row) const { return field(row, 1); }
+    quint32 countyId(int row) const { return field(row, 2); }
+    quint32 stateId(int row) const { return field(row, 3); }
+    QString string(quint32 id) const;
+    int stringLength(quint32 id) const;
+    QVector<quint32> longestStrings(int column, int count) const;
+
+    QString postOffice(int row) const
+        { return string(postOfficeId(row)); }
+    QString county(int row) const { return string(countyId(row)); }
+    QString state(int row) const { return string(stateId(row)); }
+
+private:
+    quint32 field(int row, int column) const;
+    bool stringBounds(quint32 id, quint64 *begin, quint64 *end) const;
+
+    QFile m_file;
+    QByteArray m_buffer; // Only used if the file can't be mapped
+    const uchar *m_data;
+    qint64 m_size;
+    int m_rowCount;
+    int m_stringCount;
+    const uchar *m_stringIndex;
+    const uchar *m_strings;
+    quint64 m_stringsSize;
+    const uchar *m_rows;
+};
+
+
+// Collects rows in any order and writes them as a sorted format 200
+// file.
+
+class ZipcodeFileWriter
+{
+    Q_DECLARE_TR_FUNCTIONS(ZipcodeFileWriter)
+
+public:
+    void reserve(int rows);
+    void addRow(int zipcode, const QString &postOffice,
+                const QString &county, const QString &state);
+    void save(const QString &filename);
+
+private:
+    quint32 intern(const QString &text);
+
+    QVector<quint32> m_rows;
+    QVector<QString> m_strings;
+    QHash<QString, quint32> m_idForString;
+};
+
+#endif // ZIPCODEFILE_HPP
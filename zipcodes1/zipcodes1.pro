@@ -11,6 +11,8 @@ HEADERS	     += global.hpp
 HEADERS	     += zipcodespinbox.hpp
 HEADERS	     += itemdelegate.hpp
 SOURCES	     += itemdelegate.cpp
+HEADERS	     += zipcodefile.hpp
+SOURCES	     += zipcodefile.cpp
 HEADERS	     += standardtablemodel.hpp
 SOURCES      += standardtablemodel.cpp
 HEADERS	     += proxymodel.hpp
@@ -21,7 +23,7 @@ HEADERS	     += mainwindow.hpp
 SOURCES      += mainwindow.cpp
 SOURCES      += main.cpp
 TRANSLATIONS += zipcodes_en.ts
-QT += widgets #added for Qt5
+QT += widgets concurrent #added for Qt5
 
 debug {
     exists(../modeltest-0.2/modeltest.pri) {
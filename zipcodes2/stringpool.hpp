@@ -0,0 +1,52 @@
+#ifndef STRINGPOOL_HPP
+#define STRINGPOOL_HPP
+/*
+    Copyright (c) 2009-10 Qtrac Ltd. All rights reserved.
+
+    This program or module is free software: you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version. It is provided
+    for educational purposes and is distributed in the hope that it will
+    be useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+    the GNU General Public License for more details.
+*/
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+
+// Holds each distinct string once and hands out small integer ids for
+// them. The QHash key and the QVector entry share the same implicitly
+// shared QString data, so each string's characters are stored once.
+// Ids are never reused, so a string that is no longer referenced stays
+// in the pool until clear() is called.
+
+class StringPool
+{
+public:
+    quint32 intern(const QString &text)
+    {
+        QHash<QString, quint32>::const_iterator i =
+                idForString.constFind(text);
+        if (i != idForString.constEnd())
+            return i.value();
+        const quint32 id = static_cast<quint32>(strings.count());
+        strings << text;
+        idForString.insert(text, id);
+        return id;
+    }
+
+    const QString &string(quint32 id) const { return strings.at(id); }
+    int count() const { return strings.count(); }
+    void clear() { strings.clear(); idForString.clear(); }
+    void squeeze() { strings.squeeze(); idForString.squeeze(); }
+
+private:
+    QVector<QString> strings;
+    QHash<QString, quint32> idForString;
+};
+
+#endif // STRINGPOOL_HPP
@@ -14,25 +14,69 @@
 #include "aqp.hpp"
 #include "global.hpp"
 #include "tablemodel.hpp"
+#include "zipcodefile.hpp"
 #include <QApplication>
 #include <QDataStream>
 #include <QFile>
 #include <QFontMetrics>
+#include <QStringList>
 #include <QStyleOptionComboBox>
+#include <QtAlgorithms>
 
 
 namespace {
-const qint32 MagicNumber = 0x5A697043;
-const qint16 FormatNumber = 100;
 const int MaxColumns = 4;
+const int MeasuredMappedStrings = 32;
+
+
+// Orders row numbers the same way ZipcodeItem::operator<() orders items
+class RowLessThan
+{
+public:
+    RowLessThan(const QVector<quint32> &zipcodes,
+                const QVector<quint32> &postOfficeIds,
+                const StringPool &postOffices)
+        : zipcodes(zipcodes), postOfficeIds(postOfficeIds),
+          postOffices(postOffices) {}
+
+    bool operator()(int a, int b) const
+    {
+        const int zipcodeA = static_cast<int>(zipcodes.at(a));
+        const int zipcodeB = static_cast<int>(zipcodes.at(b));
+        if (zipcodeA != zipcodeB)
+            return zipcodeA < zipcodeB;
+        return postOffices.string(postOfficeIds.at(a)) <
+               postOffices.string(postOfficeIds.at(b));
+    }
+
+private:
+    const QVector<quint32> &zipcodes;
+    const QVector<quint32> &postOfficeIds;
+    const StringPool &postOffices;
+};
+
+
+template<typename T>
+QVector<T> permuted(const QVector<T> &column, const QVector<int> &order)
+{
+    QVector<T> result(column.count());
+    for (int i = 0; i < order.count(); ++i)
+        result[i] = column.at(order.at(i));
+    return result;
 }
 
 
-QDataStream &operator<<(QDataStream &out, const ZipcodeItem &item)
+quint32 internFileString(StringPool *pool, QVector<qint64> *idForFileId,
+                         const ZipcodeFile &file, quint32 fileId)
 {
-    out << static_cast<quint16>(item.zipcode) << item.postOffice
-        << item.county << item.state;
-    return out;
+    if (fileId >= static_cast<quint32>(idForFileId->count()))
+        return pool->intern(QString());
+    qint64 &id = (*idForFileId)[fileId];
+    if (id == -1)
+        id = pool->intern(file.string(fileId));
+    return static_cast<quint32>(id);
+}
+
 }
 
 
@@ -58,41 +102,19 @@ Qt::ItemFlags TableModel::flags(const QModelIndex &index) const
 QVariant TableModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid() ||
-        index.row() < 0 || index.row() >= zipcodes.count() ||
+        index.row() < 0 || index.row() >= zipcodeCount() ||
         index.column() < 0 || index.column() >= MaxColumns)
         return QVariant();
-    const ZipcodeItem &item = zipcodes.at(index.row());
-    if (role == Qt::SizeHintRole) {
-        QStyleOptionComboBox option;
-        switch (index.column()) {
-            case Zipcode: {
-                option.currentText = QString::number(MaxZipcode);
-                const QString header = headerData(Zipcode,
-                        Qt::Horizontal, Qt::DisplayRole).toString();
-                if (header.length() > option.currentText.length())
-                    option.currentText = header;
-                break;
-            }
-            case PostOffice: option.currentText = item.postOffice;
-                             break;
-            case County: option.currentText = item.county; break;
-            case State: option.currentText = item.state; break;
-            default: Q_ASSERT(false);
-        }
-        QFontMetrics fontMetrics(data(index, Qt::FontRole)
-                                 .value<QFont>());
-        option.fontMetrics = fontMetrics;
-        QSize size(fontMetrics.width(option.currentText),
-                   fontMetrics.height());
-        return qApp->style()->sizeFromContents(QStyle::CT_ComboBox,
-                                               &option, size);
-    }
+    const int row = index.row();
+    if (role == Qt::SizeHintRole)
+        return sizeHintFor(index.column(),
+                           data(index, Qt::FontRole).value<QFont>());
     if (role == Qt::DisplayRole || role == Qt::EditRole) {
         switch (index.column()) {
-            case Zipcode: return item.zipcode;
-            case PostOffice: return item.postOffice;
-            case County: return item.county;
-            case State: return item.state;
+            case Zipcode: return zipcodeAt(row);
+            case PostOffice: // Fallthrough
+            case County: // Fallthrough
+            case State: return textAt(row, index.column());
             default: Q_ASSERT(false);
         }
     }
@@ -100,6 +122,66 @@ QVariant TableModel::data(const QModelIndex &index, int role) const
 }
 
 
+// Every row in a column gets the same size hint: the one for the
+// column's widest text. Each distinct string in the column is measured
+// once and the results are kept until the font or style changes or a
+// string is added. For a mapped file only the column's longest strings
+// are decoded and measured, since the widest is almost certainly one of
+// them, and decoding all of them would undo the lazy loading.
+QSize TableModel::sizeHintFor(int column, const QFont &font) const
+{
+    QStyle *style = qApp->style();
+    const QString fontKey = font.key();
+    if (style != sizeHintStyle || fontKey != sizeHintFontKey) {
+        sizeHints.clear();
+        sizeHintStyle = style;
+        sizeHintFontKey = fontKey;
+    }
+    if (sizeHints.isEmpty())
+        sizeHints.resize(MaxColumns);
+    QSize &size = sizeHints[column];
+    if (size.isValid())
+        return size;
+
+    QFontMetrics fontMetrics(font);
+    QStyleOptionComboBox option;
+    option.fontMetrics = fontMetrics;
+    if (column == Zipcode) {
+        option.currentText = QString::number(MaxZipcode);
+        const QString header = headerData(Zipcode, Qt::Horizontal,
+                                          Qt::DisplayRole).toString();
+        if (header.length() > option.currentText.length())
+            option.currentText = header;
+    }
+    else {
+        QStringList texts;
+        if (mapped.isOpen()) {
+            foreach (const quint32 id, mapped.longestStrings(column,
+                    MeasuredMappedStrings))
+                texts << mapped.string(id);
+        }
+        else {
+            const StringPool &pool = column == PostOffice ? postOffices
+                    : column == County ? counties : states;
+            for (int id = 0; id < pool.count(); ++id)
+                texts << pool.string(id);
+        }
+        int widest = -1;
+        foreach (const QString &text, texts) {
+            const int width = fontMetrics.width(text);
+            if (width > widest) {
+                widest = width;
+                option.currentText = text;
+            }
+        }
+    }
+    size = qApp->style()->sizeFromContents(QStyle::CT_ComboBox, &option,
+            QSize(fontMetrics.width(option.currentText),
+                  fontMetrics.height()));
+    return size;
+}
+
+
 QVariant TableModel::headerData(int section,
         Qt::Orientation orientation, int role) const
 {
@@ -120,7 +202,7 @@ QVariant TableModel::headerData(int section,
 
 int TableModel::rowCount(const QModelIndex &index) const
 {
-    return index.isValid() ? 0 : zipcodes.count();
+    return index.isValid() ? 0 : zipcodeCount();
 }
 
 
@@ -134,24 +216,31 @@ bool TableModel::setData(const QModelIndex &index,
                          const QVariant &value, int role)
 {
     if (!index.isValid() || role != Qt::EditRole ||
-        index.row() < 0 || index.row() >= zipcodes.count() ||
+        index.row() < 0 || index.row() >= zipcodeCount() ||
         index.column() < 0 || index.column() >= MaxColumns)
         return false;
-    ZipcodeItem &item = zipcodes[index.row()];
+    detach();
+    const int row = index.row();
     switch (index.column()) {
         case Zipcode: {
             bool ok;
             int zipcode = value.toInt(&ok);
             if (!ok || zipcode < MinZipcode || zipcode > MaxZipcode)
                 return false;
-            item.zipcode = zipcode;
+            zipcodes[row] = static_cast<quint32>(zipcode);
             break;
         }
-        case PostOffice: item.postOffice = value.toString(); break;
-        case County: item.county = value.toString(); break;
-        case State: item.state = value.toString(); break;
+        case PostOffice:
+            postOfficeIds[row] = postOffices.intern(value.toString());
+            break;
+        case County:
+            countyIds[row] = counties.intern(value.toString());
+            break;
+        case State: stateIds[row] = states.intern(value.toString());
+                    break;
         default: Q_ASSERT(false);
     }
+    sizeHints.clear();
     emit dataChanged(index, index);
     return true;
 }
@@ -159,9 +248,14 @@ bool TableModel::setData(const QModelIndex &index,
 
 bool TableModel::insertRows(int row, int count, const QModelIndex&)
 {
+    detach();
     beginInsertRows(QModelIndex(), row, row + count - 1);
-    for (int i = 0; i < count; ++i)
-        zipcodes.insert(row, ZipcodeItem());
+    const ZipcodeItem item;
+    zipcodes.insert(row, count, static_cast<quint32>(item.zipcode));
+    postOfficeIds.insert(row, count, postOffices.intern(item.postOffice));
+    countyIds.insert(row, count, counties.intern(item.county));
+    stateIds.insert(row, count, states.intern(item.state));
+    sizeHints.clear();
     endInsertRows();
     return true;
 }
@@ -169,9 +263,12 @@ bool TableModel::insertRows(int row, int count, const QModelIndex&)
 
 bool TableModel::removeRows(int row, int count, const QModelIndex&)
 {
+    detach();
     beginRemoveRows(QModelIndex(), row, row + count - 1);
-    for (int i = 0; i < count; ++i)
-        zipcodes.removeAt(row);
+    zipcodes.remove(row, count);
+    postOfficeIds.remove(row, count);
+    countyIds.remove(row, count);
+    stateIds.remove(row, count);
     endRemoveRows();
     return true;
 }
@@ -190,23 +287,36 @@ void TableModel::load(const QString &filename)
     QDataStream in(&file);
     qint32 magicNumber;
     in >> magicNumber;
-    if (magicNumber != MagicNumber)
+    if (magicNumber != ZipcodeFile::MagicNumber)
         throw AQP::Error(tr("unrecognized file type"));
     qint16 formatVersionNumber;
     in >> formatVersionNumber;
-    if (formatVersionNumber > FormatNumber)
+    if (formatVersionNumber > ZipcodeFile::FormatNumber)
         throw AQP::Error(tr("file format version is too new"));
-    in.setVersion(QDataStream::Qt_4_5);
-    zipcodes.clear();
-
-    ZipcodeItem item;
-    while (!in.atEnd()) {
-        in >> item;
-        zipcodes << item;
-    }
-    qSort(zipcodes);
+    // The reset spans the clearing of the old rows, so attached views
+    // are told even if the new file turns out to be corrupt
     //reset();         //deleted for Qt5
     beginResetModel(); //added for Qt5
+    clearRows();
+    try {
+        if (formatVersionNumber == ZipcodeFile::FormatNumber) {
+            file.close();
+            mapped.open(m_filename); // Rows are decoded when needed
+        }
+        else {
+            in.setVersion(QDataStream::Qt_4_5);
+            ZipcodeItem item;
+            while (!in.atEnd()) {
+                in >> item;
+                appendRow(item);
+            }
+            sortRows();
+        }
+    } catch (AQP::Error&) {
+        clearRows();
+        endResetModel();
+        throw;
+    }
     endResetModel();   //added for Qt5
 }
 
@@ -217,14 +327,109 @@ void TableModel::save(const QString &filename)
         m_filename = filename;
     if (m_filename.isEmpty())
         throw AQP::Error(tr("no filename specified"));
-    QFile file(m_filename);
-    if (!file.open(QIODevice::WriteOnly))
-        throw AQP::Error(file.errorString());
+    detach(); // Never write over a file that is still mapped
+
+    ZipcodeFileWriter writer;
+    writer.reserve(zipcodes.count());
+    for (int row = 0; row < zipcodes.count(); ++row)
+        writer.addRow(static_cast<int>(zipcodes.at(row)),
+                      postOffices.string(postOfficeIds.at(row)),
+                      counties.string(countyIds.at(row)),
+                      states.string(stateIds.at(row)));
+    writer.save(m_filename);
+}
+
+
+int TableModel::zipcodeAt(int row) const
+{
+    return mapped.isOpen() ? mapped.zipcode(row)
+                           : static_cast<int>(zipcodes.at(row));
+}
+
+
+QString TableModel::textAt(int row, int column) const
+{
+    switch (column) {
+        case PostOffice: return mapped.isOpen() ? mapped.postOffice(row)
+                : postOffices.string(postOfficeIds.at(row));
+        case County: return mapped.isOpen() ? mapped.county(row)
+                : counties.string(countyIds.at(row));
+        case State: return mapped.isOpen() ? mapped.state(row)
+                : states.string(stateIds.at(row));
+        default: Q_ASSERT(false);
+    }
+    return QString();
+}
 
-    QDataStream out(&file);
-    out << MagicNumber << FormatNumber;
-    out.setVersion(QDataStream::Qt_4_5);
-    QListIterator<ZipcodeItem> i(zipcodes);
-    while (i.hasNext())
-        out << i.next();
+
+// Copies the mapped file's rows into the columns so that they can be
+// edited; each distinct string is decoded only once
+void TableModel::detach()
+{
+    if (!mapped.isOpen())
+        return;
+    const int count = mapped.rowCount();
+    zipcodes.reserve(count);
+    postOfficeIds.reserve(count);
+    countyIds.reserve(count);
+    stateIds.reserve(count);
+    QVector<qint64> postOfficeIdFor(mapped.stringCount(), -1);
+    QVector<qint64> countyIdFor(mapped.stringCount(), -1);
+    QVector<qint64> stateIdFor(mapped.stringCount(), -1);
+    for (int row = 0; row < count; ++row) {
+        zipcodes << static_cast<quint32>(mapped.zipcode(row));
+        postOfficeIds << internFileString(&postOffices, &postOfficeIdFor,
+                mapped, mapped.postOfficeId(row));
+        countyIds << internFileString(&counties, &countyIdFor, mapped,
+                                      mapped.countyId(row));
+        stateIds << internFileString(&states, &stateIdFor, mapped,
+                                     mapped.stateId(row));
+    }
+    mapped.close();
+}
+
+
+void TableModel::clearRows()
+{
+    mapped.close();
+    sizeHints.clear();
+    zipcodes.clear();
+    postOfficeIds.clear();
+    countyIds.clear();
+    stateIds.clear();
+    postOffices.clear();
+    counties.clear();
+    states.clear();
+}
+
+
+void TableModel::appendRow(const ZipcodeItem &item)
+{
+    zipcodes << static_cast<quint32>(item.zipcode);
+    postOfficeIds << postOffices.intern(item.postOffice);
+    countyIds << counties.intern(item.county);
+    stateIds << states.intern(item.state);
+}
+
+
+// Sorts a vector of row numbers rather than the rows themselves, then
+// applies that order to each column in turn
+void TableModel::sortRows()
+{
+    QVector<int> order(zipcodes.count());
+    for (int i = 0; i < order.count(); ++i)
+        order[i] = i;
+    qStableSort(order.begin(), order.end(),
+                RowLessThan(zipcodes, postOfficeIds, postOffices));
+    zipcodes = permuted(zipcodes, order);
+    postOfficeIds = permuted(postOfficeIds, order);
+    countyIds = permuted(countyIds, order);
+    stateIds = permuted(stateIds, order);
+    zipcodes.squeeze();
+    postOfficeIds.squeeze();
+    countyIds.squeeze();
+    stateIds.squeeze();
+    postOffices.squeeze();
+    counties.squeeze();
+    states.squeeze();
 }
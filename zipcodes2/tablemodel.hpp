@@ -13,8 +13,16 @@
     the GNU General Public License for more details.
 */
 
+#include "stringpool.hpp"
+#include "zipcodefile.hpp"
 #include "zipcodeitem.hpp"
 #include <QAbstractTableModel>
+#include <QFont>
+#include <QSize>
+#include <QVector>
+
+
+class QStyle;
 
 
 class TableModel : public QAbstractTableModel
@@ -23,7 +31,7 @@ class TableModel : public QAbstractTableModel
 
 public:
     explicit TableModel(QObject *parent=0)
-        : QAbstractTableModel(parent) {}
+        : QAbstractTableModel(parent), sizeHintStyle(0) {}
 
     Qt::ItemFlags flags(const QModelIndex &index) const;
     QVariant data(const QModelIndex &index,
@@ -48,8 +56,35 @@ public:
     void save(const QString &filename=QString());
 
 private:
+    int zipcodeCount() const
+        { return mapped.isOpen() ? mapped.rowCount() : zipcodes.count(); }
+    int zipcodeAt(int row) const;
+    QString textAt(int row, int column) const;
+    QSize sizeHintFor(int column, const QFont &font) const;
+    void detach();
+    void clearRows();
+    void appendRow(const ZipcodeItem &item);
+    void sortRows();
+
     QString m_filename;
-    QList<ZipcodeItem> zipcodes;
+    // Format 200 files are read straight from the mapping until the
+    // first edit, when detach() copies them into the columns
+    ZipcodeFile mapped;
+    // One entry per row in each column; the strings are interned.
+    // Zipcodes are numeric and limited to MinZipcode..MaxZipcode like
+    // the quint16 on-disk records, so alphanumeric international
+    // postcodes cannot be held
+    QVector<quint32> zipcodes;
+    QVector<quint32> postOfficeIds;
+    QVector<quint32> countyIds;
+    QVector<quint32> stateIds;
+    StringPool postOffices;
+    StringPool counties;
+    StringPool states;
+    // One per column; empty or invalid until first asked for
+    mutable QVector<QSize> sizeHints;
+    mutable QStyle *sizeHintStyle;
+    mutable QString sizeHintFontKey;
 };
 
 #endif // TABLEMODEL_HPP
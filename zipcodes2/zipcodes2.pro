@@ -11,6 +11,8 @@ HEADERS	     += ../zipcodes1/global.hpp
 HEADERS	     += ../zipcodes1/zipcodespinbox.hpp
 HEADERS	     += ../zipcodes1/itemdelegate.hpp
 SOURCES	     += ../zipcodes1/itemdelegate.cpp
+HEADERS	     += ../zipcodes1/zipcodefile.hpp
+SOURCES	     += ../zipcodes1/zipcodefile.cpp
 HEADERS	     += ../zipcodes1/proxymodel.hpp
 SOURCES	     += ../zipcodes1/proxymodel.cpp
 HEADERS	     += ../zipcodes1/uniqueproxymodel.hpp
@@ -21,6 +23,7 @@ SOURCES      += ../zipcodes1/main.cpp
 TRANSLATIONS += ../zipcodes1/zipcodes_en.ts
 INCLUDEPATH  += ../zipcodes1
 DEFINES	     += CUSTOM_MODEL
+HEADERS	     += stringpool.hpp
 HEADERS	     += zipcodeitem.hpp
 HEADERS	     += tablemodel.hpp
 SOURCES      += tablemodel.cpp